@@ -8,9 +8,17 @@ LOCAL_C_INCLUDES := bionic
 LOCAL_C_INCLUDES += $(LOCAL_PATH)
 LOCAL_C_INCLUDES += $(LIBUSB_ROOT_ABS)
 LOCAL_SHARED_LIBRARIES += libusb1.0
-LOCAL_SRC_FILES:= gpio.c adc.c pwm.c i2c.c spi.c can.c uart.c usb.c main.c
+LOCAL_SRC_FILES:= gpio.c gpio_event.c gpio_capture.c gpio_waveform.c gpio_pinmux.c gpio_counter.c gpio_encoder.c gpio_softspi.c gpio_onewire.c gpio_parallel.c gpio_stepper.c gpio_softpwm.c gpio_keypad.c gpio_arbiter.c adc.c pwm.c pwm_stream.c pwm_servo.c i2c.c spi.c can.c uart.c usb.c main.c
 LOCAL_MODULE := testHal
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wall
+LOCAL_C_INCLUDES := bionic
+LOCAL_C_INCLUDES += $(LOCAL_PATH)
+LOCAL_SRC_FILES:= gpio_arbiterd.c gpio_arbiter.c gpio.c
+LOCAL_MODULE := gpio_arbiterd
+include $(BUILD_EXECUTABLE)
 endif  # TARGET_SIMULATOR != true
 
 include include/libusb/android/jni/libusb.mk
\ No newline at end of file
@@ -14,6 +14,7 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 
 #ifndef __BBBANDROIDHAL_H__
 #define __BBBANDROIDHAL_H__
@@ -27,11 +28,257 @@ extern int openBBBAndroidHAL(void);
 extern int closeBBBAndroidHAL(void);
 
 /* GPIO interfacing functions */
+#define GPIO_ACCESS_SYSFS 0	/**< openGPIO() mode using /sys/class/gpio value files */
+#define GPIO_ACCESS_MMAP  1	/**< openGPIO() mode using /dev/mem mapped bank registers */
+#define GPIO_ACCESS_CDEV  2	/**< openGPIO() mode using /dev/gpiochipN line requests */
+
+typedef struct GPIOPlan GPIOPlan_t;
+
 extern int openGPIO(const int useMmap);
 extern int readGPIO(const unsigned int header, const unsigned int pin);
 extern int writeGPIO(const unsigned int header, const unsigned int pin,
 const unsigned int value);
 extern void closeGPIO(void);
+extern int gpioPinMask(const unsigned int header, const unsigned int pin,
+unsigned int *bank, uint32_t *mask);
+
+/* GPIO multi-pin functions */
+extern GPIOPlan_t *gpioPlanCreate(const unsigned int headers[], const unsigned int pins[],
+const int count);
+extern int gpioReadMask(const GPIOPlan_t *plan, uint32_t *values);
+extern int gpioWriteMask(const GPIOPlan_t *plan, const uint32_t values);
+extern void gpioPlanFree(GPIOPlan_t *plan);
+
+/* GPIO parallel bus functions */
+typedef struct GPIOParallel GPIOParallel_t;
+
+extern GPIOParallel_t *gpioParallelCreate(const unsigned int headers[], const unsigned int pins[],
+const int count, const unsigned int strobeHeader, const unsigned int strobePin,
+const int strobeActiveLow);
+extern int gpioParallelWrite(const GPIOParallel_t *bus, const uint32_t word);
+extern int gpioParallelStream(const GPIOParallel_t *bus, const uint32_t words[], const int count,
+const uint32_t pulse_ns);
+extern void gpioParallelFree(GPIOParallel_t *bus);
+
+/* GPIO direction functions */
+#define GPIO_DIRECTION_INPUT  0		/**< Pin is an input */
+#define GPIO_DIRECTION_OUTPUT 1		/**< Pin is an output */
+#define GPIO_DIRECTION_KEEP   -1	/**< gpioAcquire() leaves the direction unchanged */
+
+extern int gpioSetDirection(const unsigned int header, const unsigned int pin,
+const int direction);
+extern int gpioGetDirection(const unsigned int header, const unsigned int pin);
+extern int gpioSetDirectionMask(GPIOPlan_t *plan, const uint32_t outputs);
+
+/* GPIO pin handle functions */
+/**
+ * typedef struct GPIOPin_t for a pin resolved once by gpioAcquire().
+ * The fields are filled in by gpioAcquire() and must not be changed by callers.
+ */
+
+typedef struct {
+  volatile uint32_t *dataIn;    /**< MMAP: DATA IN register of the pin's bank, NULL for other access methods */
+  volatile uint32_t *setOut;    /**< MMAP: SET DATA OUT register of the pin's bank, NULL for an input */
+  volatile uint32_t *clearOut;  /**< MMAP: CLEAR DATA OUT register of the pin's bank */
+  uint32_t mask;                /**< Bit of the pin in its bank */
+  uint32_t state;               /**< Last value written, as mask or 0, used by gpioPinToggle() */
+  const void *pinInfo;          /**< Pin table entry used by the slow path */
+} GPIOPin_t;
+
+extern GPIOPin_t *gpioAcquire(const unsigned int header, const unsigned int pin,
+const int direction);
+extern int gpioPinReadSlow(const GPIOPin_t *handle);
+extern int gpioPinWriteSlow(const GPIOPin_t *handle, const unsigned int value);
+extern void gpioRelease(GPIOPin_t *handle);
+
+/**
+ * It reads the pin of a handle returned by gpioAcquire(). Using memory map this is a single load.
+ * @param handle a constant GPIOPin_t pointer argument.
+ * @return 1 if read 1 and 0 if read 0;
+ */
+
+static inline int gpioPinRead(const GPIOPin_t *handle)
+{
+  if (handle->dataIn)
+    return (*handle->dataIn & handle->mask) != 0;
+  return gpioPinReadSlow(handle);
+}
+
+/**
+ * It writes the pin of a handle returned by gpioAcquire(). Using memory map this is a single store.
+ * @param handle a GPIOPin_t pointer argument.
+ * @param value a constant unsigned int argument.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+static inline int gpioPinWrite(GPIOPin_t *handle, const unsigned int value)
+{
+  handle->state = value ? handle->mask : 0;
+  if (handle->setOut) {
+    if (value)
+      *handle->setOut = handle->mask;
+    else
+      *handle->clearOut = handle->mask;
+    return 0;
+  }
+  return gpioPinWriteSlow(handle, value);
+}
+
+/**
+ * It inverts the last value written to the pin of a handle returned by gpioAcquire().
+ * Using memory map this is a single store.
+ * @param handle a GPIOPin_t pointer argument.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+static inline int gpioPinToggle(GPIOPin_t *handle)
+{
+  return gpioPinWrite(handle, !handle->state);
+}
+
+/* GPIO edge event functions */
+#define GPIO_EDGE_NONE    0	/**< No edge events */
+#define GPIO_EDGE_RISING  1	/**< Events on rising edges */
+#define GPIO_EDGE_FALLING 2	/**< Events on falling edges */
+#define GPIO_EDGE_BOTH    3	/**< Events on both edges */
+
+typedef struct {
+  uint8_t header;      /**< Header of the pin */
+  uint8_t pin;         /**< Pin that changed */
+  uint8_t value;       /**< Value read after the edge */
+  uint64_t timestamp;  /**< CLOCK_MONOTONIC time of the event in nano seconds */
+} GPIOEvent_t;
+
+extern int gpioSetEdge(const unsigned int header, const unsigned int pin, const int edge);
+extern int gpioEventAdd(const unsigned int header, const unsigned int pin);
+extern int gpioEventRemove(const unsigned int header, const unsigned int pin);
+extern int gpioEventWait(const int timeout_ms);
+extern int gpioEventRead(GPIOEvent_t events[], const int max);
+extern unsigned int gpioEventDropped(void);
+extern int gpioEventFilter(const unsigned int header, const unsigned int pin,
+const uint32_t stable_us, const uint32_t glitch_us);
+extern uint32_t gpioEventSuppressed(const unsigned int header, const unsigned int pin);
+extern void gpioEventClose(void);
+
+/* GPIO matrix keypad functions */
+typedef struct {
+  uint8_t row;         /**< Row of the key */
+  uint8_t col;         /**< Column of the key */
+  uint8_t down;        /**< 1 if the key was pressed and 0 if it was released */
+  uint64_t timestamp;  /**< CLOCK_MONOTONIC time of the scan that saw the change in nano seconds */
+} GPIOKeyEvent_t;
+
+extern int gpioKeypadStart(const unsigned int rowHeaders[], const unsigned int rowPins[], const int rows,
+const unsigned int colHeaders[], const unsigned int colPins[], const int cols,
+const uint32_t scan_us, const int debounce);
+extern int gpioKeypadRead(GPIOKeyEvent_t events[], const int max);
+extern unsigned int gpioKeypadDropped(void);
+extern void gpioKeypadStop(void);
+
+/* GPIO edge counting functions */
+
+/**
+ * typedef struct GPIOCount_t for the counts of a pin measured by the counting service.
+ */
+
+typedef struct {
+  uint64_t edges;       /**< Number of edges seen */
+  uint64_t rising;      /**< Number of rising edges seen */
+  uint32_t period_ns;   /**< Time between the last two rising edges in nano seconds */
+  uint32_t high_ns;     /**< Time the pin was last high in nano seconds */
+  uint64_t timestamp;   /**< CLOCK_MONOTONIC time of the last edge in nano seconds */
+} GPIOCount_t;
+
+extern int gpioCounterAdd(const unsigned int header, const unsigned int pin);
+extern int gpioCounterStart(const int cpu, const uint32_t poll_us);
+extern int gpioCounterRead(const unsigned int header, const unsigned int pin, GPIOCount_t *count);
+extern double gpioCounterFrequency(const unsigned int header, const unsigned int pin);
+extern double gpioCounterDuty(const unsigned int header, const unsigned int pin);
+extern void gpioCounterStop(void);
+
+/* Quadrature encoder functions */
+extern int gpioEncoderAdd(const unsigned int headerA, const unsigned int pinA,
+const unsigned int headerB, const unsigned int pinB);
+extern int gpioEncoderStart(const int cpu, const uint32_t sample_us, const uint32_t window_us);
+extern int64_t gpioEncoderPosition(const int index);
+extern double gpioEncoderVelocity(const int index);
+extern uint32_t gpioEncoderErrors(const int index);
+extern void gpioEncoderStop(void);
+
+/* GPIO pad configuration functions */
+#define GPIO_PULL_NONE 0	/**< Pad pull resistor disabled */
+#define GPIO_PULL_DOWN 1	/**< Pad pull-down resistor enabled */
+#define GPIO_PULL_UP   2	/**< Pad pull-up resistor enabled */
+
+extern int gpioPadSet(const unsigned int header, const unsigned int pin, const int mode,
+const int pull, const int rxEnable, const int slowSlew);
+extern int gpioPadSetRaw(const unsigned int header, const unsigned int pin, const uint32_t value);
+extern int gpioPadGet(const unsigned int header, const unsigned int pin);
+extern void gpioPadClose(void);
+
+/* GPIO logic analyzer capture functions */
+typedef struct GPIOCapture GPIOCapture_t;
+
+extern GPIOCapture_t *gpioCaptureCreate(const unsigned int headers[], const unsigned int pins[],
+const int count, const uint32_t maxRecords);
+extern int gpioCaptureStart(GPIOCapture_t *cap, const uint64_t maxSamples, const int cpu);
+extern int gpioCaptureStop(GPIOCapture_t *cap, const int stop);
+extern double gpioCaptureRate(const GPIOCapture_t *cap);
+extern int gpioCaptureExportVCD(const GPIOCapture_t *cap, const char *path);
+extern int gpioCaptureExportBinary(const GPIOCapture_t *cap, const char *path);
+extern void gpioCaptureFree(GPIOCapture_t *cap);
+
+/* GPIO waveform playback functions */
+typedef struct GPIOWaveform GPIOWaveform_t;
+
+/**
+ * typedef struct GPIOWaveStep_t for one step of a waveform.
+ * The masks use the bank layout of the GPIO registers, bank 0 to 3.
+ */
+
+typedef struct {
+  uint32_t set[4];    /**< Bits driven high in each bank */
+  uint32_t clear[4];  /**< Bits driven low in each bank */
+  uint32_t delay_ns;  /**< Time until the next step in nano seconds */
+} GPIOWaveStep_t;
+
+extern GPIOWaveform_t *gpioWaveformCreate(const GPIOWaveStep_t steps[], const uint32_t count);
+extern int gpioWaveformPlay(GPIOWaveform_t *wave, const uint32_t budget_ns, const int cpu);
+extern int32_t gpioWaveformJitter(const GPIOWaveform_t *wave, int32_t jitter[], const uint32_t max);
+extern void gpioWaveformFree(GPIOWaveform_t *wave);
+
+/* GPIO stepper motor functions */
+extern int gpioStepperAdd(const unsigned int stepHeader, const unsigned int stepPin,
+const unsigned int dirHeader, const unsigned int dirPin);
+extern int gpioStepperStart(const int cpu, const uint32_t tick_ns);
+extern int gpioStepperMove(const int32_t steps[], const double rate, const double accel, const double jerk);
+extern int gpioStepperPending(void);
+extern int64_t gpioStepperPosition(const int index);
+extern void gpioStepperStop(void);
+
+/* GPIO software PWM functions */
+extern int softPwmAdd(const unsigned int header, const unsigned int pin);
+extern int softPwmStart(const uint32_t period_ns, const int cpu);
+extern int softPwmSetDuty(const int channel, const uint32_t duty_ns);
+extern int softPwmGetDuty(const int channel);
+extern void softPwmStop(void);
+
+/* GPIO multi-process arbitration functions */
+#define GPIO_ARBITER_PATH "/data/local/tmp/bbbgpio_arbiter"	/**< Unix socket of the arbitration daemon */
+
+extern int gpioArbiterServe(const int uid, const int gid);
+extern void gpioArbiterShutdown(void);
+extern int gpioArbiterConnect(void);
+extern int gpioArbiterClaim(const unsigned int header, const unsigned int pin);
+extern int gpioArbiterRelease(const unsigned int header, const unsigned int pin);
+extern int gpioArbiterSetDirection(const unsigned int header, const unsigned int pin, const int direction);
+extern int gpioArbiterWrite(const unsigned int header, const unsigned int pin, const unsigned int value);
+extern int gpioArbiterRead(const unsigned int header, const unsigned int pin);
+extern int gpioArbiterFlush(void);
+extern void gpioArbiterDisconnect(void);
+
+#define PWM_BACKEND_SYSFS 0	/**< pwmSetBackend() backend using /sys/class/pwm attribute files */
+#define PWM_BACKEND_MMAP  1	/**< pwmSetBackend() backend using /dev/mem mapped EHRPWM registers */
 
 /* PWM interfacing functions */
 extern int pwmSetPeriod(const uint8_t channel, const uint32_t period_ns);
@@ -42,8 +289,41 @@ extern int pwmSetPolarity(const uint8_t channel, const uint8_t polarity);
 extern int pwmGetPolarity(const uint8_t channel);
 extern int pwmRun(const uint8_t channel);
 extern int pwmStop(const uint8_t channel);
+extern int pwmConfigure(const uint8_t channel, const uint32_t period_ns, const uint32_t duty_ns,
+const uint8_t polarity, const uint8_t run);
+extern int pwmSetBackend(const uint8_t channel, const int backend);
+extern void pwmClose(void);
 extern int pwmRunCheck(const uint8_t channel);
 
+/* PWM group functions */
+typedef struct PWMGroup PWMGroup_t;
+
+extern PWMGroup_t *pwmGroupCreate(const uint8_t channels[], const int count);
+extern int pwmGroupSet(PWMGroup_t *group, const int index, const uint32_t period_ns, const uint32_t duty_ns);
+extern int pwmGroupCommit(PWMGroup_t *group);
+extern int pwmGroupLatency(const PWMGroup_t *group, uint32_t *last_ns, uint32_t *max_ns);
+extern void pwmGroupFree(PWMGroup_t *group);
+
+/* PWM servo functions */
+extern int pwmServoAdd(const uint8_t channel, const uint32_t period_ns, const uint32_t minPulse_ns,
+const uint32_t maxPulse_ns, const int minDeg, const int maxDeg);
+extern int pwmServoStart(const uint32_t tick_us, const int cpu);
+extern int pwmServoSetTarget(const int servo, const int32_t angle);
+extern int pwmServoSetSlew(const int servo, const int32_t rate);
+extern int pwmServoPosition(const int servo, int32_t *angle);
+extern void pwmServoStop(void);
+
+/* PWM duty streaming functions */
+#define PWM_STREAM_SIZE 1024	/**< Maximum number of duty values in a buffer of pwmStreamQueue() */
+
+extern int pwmStreamStart(const uint8_t channel, const uint32_t rate_hz, const int cpu);
+extern int pwmStreamQueue(const uint32_t duty_ns[], const int count);
+extern int pwmStreamPending(void);
+extern unsigned int pwmStreamUnderruns(void);
+extern unsigned int pwmStreamLate(void);
+extern unsigned int pwmStreamErrors(void);
+extern void pwmStreamStop(void);
+
 /* ADC interfacing functions */
 extern int readADC(const uint8_t channel);
 
@@ -69,6 +349,28 @@ extern int spiSetSpeed(const int spiFD, const uint32_t speed);
 extern int spiSetBitsPerWord(const int spiFD, const uint8_t bpw);
 extern void spiClose(const int spiFD);
 
+/* Software SPI interfacing functions */
+#define SOFT_SPI_SCLK 0	/**< Index of the SCLK line in softSpiOpen() arrays */
+#define SOFT_SPI_MOSI 1	/**< Index of the MOSI line in softSpiOpen() arrays */
+#define SOFT_SPI_MISO 2	/**< Index of the MISO line in softSpiOpen() arrays */
+#define SOFT_SPI_CS   3	/**< Index of the CS line in softSpiOpen() arrays */
+
+extern int softSpiOpen(const unsigned int headers[4], const unsigned int pins[4],
+const uint8_t mode, const uint32_t speed, const uint8_t lsbFirst);
+extern int softSpiTransfer(const int spiID, const uint8_t tx[], const uint8_t rx[], const int len);
+extern int softSpiGetSpeed(const int spiID);
+extern void softSpiClose(const int spiID);
+
+/* 1-Wire interfacing functions */
+extern int oneWireOpen(const unsigned int header, const unsigned int pin);
+extern int oneWireReset(const int id);
+extern int oneWireWriteByte(const int id, const uint8_t byte);
+extern int oneWireReadByte(const int id);
+extern int oneWireSearch(const int id);
+extern int oneWireGetRom(const int id, const int index, uint8_t rom[8]);
+extern int oneWireReadTemperatures(const int id, int32_t milliCelsius[], const int max);
+extern void oneWireClose(const int id);
+
 /* CAN interfacing functions */
 extern int canOpenSocket(const int socket_type, const int protocol);
 extern int canOpenRaw(const char *port);
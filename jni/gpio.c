@@ -15,6 +15,10 @@
  * @brief GPIO general purpose interface code for both file system and mmap() control of GPIOs
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/**< Needed for the CPU affinity interface */
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
 #include <unistd.h>
@@ -24,78 +28,98 @@
 #include <fcntl.h> 
 #include <errno.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sched.h>
+#include "include/linux/gpio.h"
 #include "bbbandroidHAL.h"
+#include "gpio_internal.h"
 
-#define TOTAL_PINS_PER_HEADER 46		/**< Total number of pins per header in beaglebone black */
-#define GPIO_DATA_OUT_REG     0x13C		/**< GPIO DATA OUT register address */
-#define GPIO_DATA_IN_REG      0x138		/**< GPIO DATA IN register address */
-#define GPIO_OE_REG           0x134		/**< GPIO OE register address */
-#define SYSFS_GPIO_DIR        "/sys/class/gpio"		/**< File system path to access GPIO */
+#define MAX_PLAN_PINS         32		/**< Maximum number of pins in a multi-pin plan */
+#ifndef GPIO_MEM_DEV
+#define GPIO_MEM_DEV          "/dev/mem"	/**< Device mapped for the GPIO bank registers, the host tests map a register file instead */
+#endif
+#define GPIO_CHIP_DEV         "/dev/gpiochip"	/**< Character device path of a GPIO bank, suffixed with the bank number */
+#define GPIO_CONSUMER         "bbbandroidHAL"	/**< Consumer label of character device line requests */
 
 static char fsBuf[64];  /**< Buffer to store generated file system path using snprintf */
 
-/** 
- * typedef struct GPIOBit_t for storing parameters to access GPIOs using Memory Map.
- * 
+/**
+ * typedef struct GPIOChip_t for storing the character device line request of one GPIO bank.
+ * All free header lines of a bank share a single request made in openGPIO() and kept until
+ * closeGPIO(), so the values of any of them can be read or written with one ioctl and
+ * lines driven as outputs are never released while in use.
  */
 
 typedef struct {
-  unsigned int id;    /**< FS: ID is the file for the pin */
-  unsigned char bank; /**< MMAP: GPIO bank determines register */
-  unsigned int mask;  /**< MMAP: Mask determines bit in register */
-} GPIOBit_t;
+  int fdChip;                 /**< CDEV: File descriptor of /dev/gpiochipN */
+  int fdLines;                /**< CDEV: File descriptor of the line request, -1 if no lines are requested */
+  uint32_t lines;             /**< CDEV: Mask of the bank lines in the request */
+  unsigned char index[32];    /**< CDEV: Position of each bank line in the request */
+} GPIOChip_t;
+
+/**
+ * struct GPIOPlan for reading and writing a set of pins with one register access per bank.
+ * Bit i of the values passed to gpioReadMask() and gpioWriteMask() is the i-th pin of the plan.
+ */
+
+struct GPIOPlan {
+  int count;                              /**< Number of pins in the plan */
+  const GPIOBit_t *pins[MAX_PLAN_PINS];   /**< Pin information for each plan bit */
+  unsigned int bankMask[GPIO_BANKS];      /**< MMAP: All pin masks of the plan in each bank */
+  uint32_t inputs;                        /**< Plan bits of the pins known to be inputs, gpioWriteMask() refuses them */
+};
 
 /** 
  * static GPIOBit_t variable to store P8 header pins.
  */
 
 static GPIOBit_t P8_GPIO_pin_info[TOTAL_PINS_PER_HEADER] = {
- {  0, 0, 0},       /* P8_01, GND */
- {  0, 0, 0},       /* P8_02, GND */
- { 38, 1, 1 << 6},	/* P8_03, GPIO1[6] */
- { 39, 1, 1 << 7},	/* P8_04, GPIO1[7] */
- { 34, 1, 1 << 2},	/* P8_05, GPIO1[2] */
- { 35, 1, 1 << 3},	/* P8_06, GPIO1[3] */
- { 66, 2, 1 << 2},  /* P8_07, GPIO2[2] */
- { 67, 2, 1 << 3},	/* P8_08, GPIO2[3] */
- { 69, 2, 1 << 5},	/* P8_09, GPIO2[5] */
- { 68, 2, 1 << 4},	/* P8_10, GPIO2[4] */
- { 45, 1, 1 << 13},	/* P8_11, GPIO1[13] */
- { 44, 1, 1 << 12},	/* P8_12, GPIO1[12] */
- { 23, 0, 1 << 23},	/* P8_13, GPIO0[23] */
- { 26, 0, 1 << 26},	/* P8_14, GPIO0[26] */
- { 47, 1, 1 << 15},	/* P8_15, GPIO1[15] */
- { 46, 1, 1 << 14},	/* P8_16, GPIO1[14] */
- { 27, 0, 1 << 27},	/* P8_17, GPIO0[27] */
- { 65, 2, 1 << 1}, 	/* P8_18, GPIO2[1] */
- { 22, 0, 1 << 22},	/* P8_19, GPIO0[22] */
- { 63, 1, 1 << 31},	/* P8_20, GPIO1[31] */
- { 62, 1, 1 << 30},	/* P8_21, GPIO1[30] */
- { 37, 1, 1 << 5},	/* P8_22, GPIO1[5] */
- { 36, 1, 1 << 4},	/* P8_23, GPIO1[4] */
- { 33, 1, 1 << 1},	/* P8_24, GPIO1[1] */
- { 32, 1, 1 << 0},	/* P8_25, GPIO1[0] */
- { 61, 1, 1 << 29},	/* P8_26, GPIO1[29] */
- { 86, 2, 1 << 22},	/* P8_27, GPIO2[22] */
- { 88, 2, 1 << 24},	/* P8_28, GPIO2[24] */
- { 87, 2, 1 << 23},	/* P8_29, GPIO2[23] */
- { 89, 2, 1 << 25},	/* P8_30, GPIO2[25] */
- { 10, 0, 1 << 10},	/* P8_31, GPIO0[10] */
- { 11, 0, 1 << 11},	/* P8_32, GPIO0[11] */
- { 9, 0, 1 << 9},	/* P8_33, GPIO0[9] */
- { 81, 2, 1 << 17},	/* P8_34, GPIO2[17] */
- { 8, 0, 1 << 8},	/* P8_35, GPIO0[8] */
- { 80, 2, 1 << 16},	/* P8_36, GPIO2[16] */
- { 78, 2, 1 << 14},	/* P8_37, GPIO2[14] */
- { 79, 2, 1 << 15},	/* P8_38, GPIO2[15] */
- { 76, 2, 1 << 12},	/* P8_39, GPIO2[12] */
- { 77, 2, 1 << 13},	/* P8_40, GPIO2[13] */
- { 74, 2, 1 << 10},	/* P8_41, GPIO2[10] */
- { 75, 2, 1 << 11},	/* P8_42, GPIO2[11] */
- { 72, 2, 1 << 8},	/* P8_43, GPIO2[8] */
- { 73, 2, 1 << 9},	/* P8_44, GPIO2[9] */
- { 70, 2, 1 << 6},	/* P8_45, GPIO2[6] */
- { 71, 2, 1 << 7}	/* P8_46, GPIO2[7] */
+ {  0, 0, 0, 0x000},       /* P8_01, GND */
+ {  0, 0, 0, 0x000},       /* P8_02, GND */
+ { 38, 1, 1 << 6, 0x018},	/* P8_03, GPIO1[6] */
+ { 39, 1, 1 << 7, 0x01C},	/* P8_04, GPIO1[7] */
+ { 34, 1, 1 << 2, 0x008},	/* P8_05, GPIO1[2] */
+ { 35, 1, 1 << 3, 0x00C},	/* P8_06, GPIO1[3] */
+ { 66, 2, 1 << 2, 0x090},  /* P8_07, GPIO2[2] */
+ { 67, 2, 1 << 3, 0x094},	/* P8_08, GPIO2[3] */
+ { 69, 2, 1 << 5, 0x09C},	/* P8_09, GPIO2[5] */
+ { 68, 2, 1 << 4, 0x098},	/* P8_10, GPIO2[4] */
+ { 45, 1, 1 << 13, 0x034},	/* P8_11, GPIO1[13] */
+ { 44, 1, 1 << 12, 0x030},	/* P8_12, GPIO1[12] */
+ { 23, 0, 1 << 23, 0x024},	/* P8_13, GPIO0[23] */
+ { 26, 0, 1 << 26, 0x028},	/* P8_14, GPIO0[26] */
+ { 47, 1, 1 << 15, 0x03C},	/* P8_15, GPIO1[15] */
+ { 46, 1, 1 << 14, 0x038},	/* P8_16, GPIO1[14] */
+ { 27, 0, 1 << 27, 0x02C},	/* P8_17, GPIO0[27] */
+ { 65, 2, 1 << 1, 0x08C}, 	/* P8_18, GPIO2[1] */
+ { 22, 0, 1 << 22, 0x020},	/* P8_19, GPIO0[22] */
+ { 63, 1, 1 << 31, 0x084},	/* P8_20, GPIO1[31] */
+ { 62, 1, 1 << 30, 0x080},	/* P8_21, GPIO1[30] */
+ { 37, 1, 1 << 5, 0x014},	/* P8_22, GPIO1[5] */
+ { 36, 1, 1 << 4, 0x010},	/* P8_23, GPIO1[4] */
+ { 33, 1, 1 << 1, 0x004},	/* P8_24, GPIO1[1] */
+ { 32, 1, 1 << 0, 0x000},	/* P8_25, GPIO1[0] */
+ { 61, 1, 1 << 29, 0x07C},	/* P8_26, GPIO1[29] */
+ { 86, 2, 1 << 22, 0x0E0},	/* P8_27, GPIO2[22] */
+ { 88, 2, 1 << 24, 0x0E8},	/* P8_28, GPIO2[24] */
+ { 87, 2, 1 << 23, 0x0E4},	/* P8_29, GPIO2[23] */
+ { 89, 2, 1 << 25, 0x0EC},	/* P8_30, GPIO2[25] */
+ { 10, 0, 1 << 10, 0x0D8},	/* P8_31, GPIO0[10] */
+ { 11, 0, 1 << 11, 0x0DC},	/* P8_32, GPIO0[11] */
+ { 9, 0, 1 << 9, 0x0D4},	/* P8_33, GPIO0[9] */
+ { 81, 2, 1 << 17, 0x0CC},	/* P8_34, GPIO2[17] */
+ { 8, 0, 1 << 8, 0x0D0},	/* P8_35, GPIO0[8] */
+ { 80, 2, 1 << 16, 0x0C8},	/* P8_36, GPIO2[16] */
+ { 78, 2, 1 << 14, 0x0C0},	/* P8_37, GPIO2[14] */
+ { 79, 2, 1 << 15, 0x0C4},	/* P8_38, GPIO2[15] */
+ { 76, 2, 1 << 12, 0x0B8},	/* P8_39, GPIO2[12] */
+ { 77, 2, 1 << 13, 0x0BC},	/* P8_40, GPIO2[13] */
+ { 74, 2, 1 << 10, 0x0B0},	/* P8_41, GPIO2[10] */
+ { 75, 2, 1 << 11, 0x0B4},	/* P8_42, GPIO2[11] */
+ { 72, 2, 1 << 8, 0x0A8},	/* P8_43, GPIO2[8] */
+ { 73, 2, 1 << 9, 0x0AC},	/* P8_44, GPIO2[9] */
+ { 70, 2, 1 << 6, 0x0A0},	/* P8_45, GPIO2[6] */
+ { 71, 2, 1 << 7, 0x0A4}	/* P8_46, GPIO2[7] */
 };
 
 /** 
@@ -103,66 +127,208 @@ static GPIOBit_t P8_GPIO_pin_info[TOTAL_PINS_PER_HEADER] = {
  */
 
 static GPIOBit_t P9_GPIO_pin_info[TOTAL_PINS_PER_HEADER] = {
- {  0, 0, 0},       /* P9_01, Power/Control */
- {  0, 0, 0},       /* P9_02, Power/Control */
- {  0, 0, 0},       /* P9_03, Power/Control */
- {  0, 0, 0},       /* P9_04, Power/Control */
- {  0, 0, 0},       /* P9_05, Power/Control */
- {  0, 0, 0},       /* P9_06, Power/Control */
- {  0, 0, 0},      	/* P9_07, Power/Control */
- {  0, 0, 0},      	/* P9_08, Power/Control */
- {  0, 0, 0},      	/* P9_09, Power/Control */
- {  0, 0, 0},      	/* P9_10, Power/Control */
- { 30, 0, 1 << 30},	/* P9_11, GPIO0[30] */
- { 60, 1, 1 << 28},	/* P9_12, GPIO1[28] */
- { 31, 0, 1 << 31},	/* P9_13, GPIO0[31] */
- { 50, 1, 1 << 18},	/* P9_14, GPIO1[18] */
- { 48, 1, 1 << 16},	/* P9_15, GPIO1[16] */
- { 51, 1, 1 << 19},	/* P9_16, GPIO1[19] */
- {  5, 0, 1 << 5}, 	/* P9_17, GPIO0[5] */
- {  4, 0, 1 << 4}, 	/* P9_18, GPIO0[4] */
- { 13, 0, 1 << 13},	/* P9_19, GPIO0[13] */
- { 12, 0, 1 << 12}, /* P9_20, GPIO0[12] */
- {  3, 0, 1 << 3}, 	/* P9_21, GPIO0[3] */
- {  2, 0, 1 << 2}, 	/* P9_22, GPIO0[2] */
- { 49, 1, 1 << 17}, /* P9_23, GPIO1[17] */
- { 15, 0, 1 << 15}, /* P9_24, GPIO0[15] */
- {117, 3, 1 << 21},	/* P9_25, GPIO3[21] */
- { 14, 0, 1 << 14}, /* P9_26, GPIO0[14] */
- {115, 3, 1 << 19}, /* P9_27, GPIO3[19] */
- {113, 3, 1 << 17}, /* P9_28, GPIO3[17] */
- {111, 3, 1 << 15}, /* P9_29, GPIO3[15] */ 
- {112, 3, 1 << 16}, /* P9_30, GPIO3[16] */
- {110, 3, 1 << 14}, /* P9_31, GPIO3[14] */
- {  0, 0, 0},       /* P9_32, ADC */
- {  0, 0, 0},       /* P9_33, ADC */
- {  0, 0, 0},       /* P9_34, ADC */
- {  0, 0, 0},       /* P9_35, ADC */
- {  0, 0, 0},       /* P9_36, ADC */
- {  0, 0, 0},       /* P9_37, ADC */
- {  0, 0, 0},       /* P9_38, ADC */
- {  0, 0, 0},       /* P9_39, ADC */
- {  0, 0, 0},       /* P9_40, ADC */
- { 20, 0, 1 << 20}, /* P9_41A, GPIO0[20] */
- {  7, 0, 1 << 7},  /* P9_42A, GPIO0[7] */
- {  0, 0, 0},       /* P9_43, GND */
- {  0, 0, 0},       /* P9_44, GND */
- {  0, 0, 0},       /* P9_45, GND */
- {  0, 0, 0}        /* P9_46, GND */
+ {  0, 0, 0, 0x000},       /* P9_01, Power/Control */
+ {  0, 0, 0, 0x000},       /* P9_02, Power/Control */
+ {  0, 0, 0, 0x000},       /* P9_03, Power/Control */
+ {  0, 0, 0, 0x000},       /* P9_04, Power/Control */
+ {  0, 0, 0, 0x000},       /* P9_05, Power/Control */
+ {  0, 0, 0, 0x000},       /* P9_06, Power/Control */
+ {  0, 0, 0, 0x000},      	/* P9_07, Power/Control */
+ {  0, 0, 0, 0x000},      	/* P9_08, Power/Control */
+ {  0, 0, 0, 0x000},      	/* P9_09, Power/Control */
+ {  0, 0, 0, 0x000},      	/* P9_10, Power/Control */
+ { 30, 0, 1 << 30, 0x070},	/* P9_11, GPIO0[30] */
+ { 60, 1, 1 << 28, 0x078},	/* P9_12, GPIO1[28] */
+ { 31, 0, 1 << 31, 0x074},	/* P9_13, GPIO0[31] */
+ { 50, 1, 1 << 18, 0x048},	/* P9_14, GPIO1[18] */
+ { 48, 1, 1 << 16, 0x040},	/* P9_15, GPIO1[16] */
+ { 51, 1, 1 << 19, 0x04C},	/* P9_16, GPIO1[19] */
+ {  5, 0, 1 << 5, 0x15C}, 	/* P9_17, GPIO0[5] */
+ {  4, 0, 1 << 4, 0x158}, 	/* P9_18, GPIO0[4] */
+ { 13, 0, 1 << 13, 0x17C},	/* P9_19, GPIO0[13] */
+ { 12, 0, 1 << 12, 0x178}, /* P9_20, GPIO0[12] */
+ {  3, 0, 1 << 3, 0x154}, 	/* P9_21, GPIO0[3] */
+ {  2, 0, 1 << 2, 0x150}, 	/* P9_22, GPIO0[2] */
+ { 49, 1, 1 << 17, 0x044}, /* P9_23, GPIO1[17] */
+ { 15, 0, 1 << 15, 0x184}, /* P9_24, GPIO0[15] */
+ {117, 3, 1 << 21, 0x1AC},	/* P9_25, GPIO3[21] */
+ { 14, 0, 1 << 14, 0x180}, /* P9_26, GPIO0[14] */
+ {115, 3, 1 << 19, 0x1A4}, /* P9_27, GPIO3[19] */
+ {113, 3, 1 << 17, 0x19C}, /* P9_28, GPIO3[17] */
+ {111, 3, 1 << 15, 0x194}, /* P9_29, GPIO3[15] */ 
+ {112, 3, 1 << 16, 0x198}, /* P9_30, GPIO3[16] */
+ {110, 3, 1 << 14, 0x190}, /* P9_31, GPIO3[14] */
+ {  0, 0, 0, 0x000},       /* P9_32, ADC */
+ {  0, 0, 0, 0x000},       /* P9_33, ADC */
+ {  0, 0, 0, 0x000},       /* P9_34, ADC */
+ {  0, 0, 0, 0x000},       /* P9_35, ADC */
+ {  0, 0, 0, 0x000},       /* P9_36, ADC */
+ {  0, 0, 0, 0x000},       /* P9_37, ADC */
+ {  0, 0, 0, 0x000},       /* P9_38, ADC */
+ {  0, 0, 0, 0x000},       /* P9_39, ADC */
+ {  0, 0, 0, 0x000},       /* P9_40, ADC */
+ { 20, 0, 1 << 20, 0x1B4}, /* P9_41A, GPIO0[20] */
+ {  7, 0, 1 << 7, 0x164},  /* P9_42A, GPIO0[7] */
+ {  0, 0, 0, 0x000},       /* P9_43, GND */
+ {  0, 0, 0, 0x000},       /* P9_44, GND */
+ {  0, 0, 0, 0x000},       /* P9_45, GND */
+ {  0, 0, 0, 0x000}        /* P9_46, GND */
 };
 
 static const uint32_t gpioAddrs[] = 
   { 0x44E07000, 0x4804C000, 0x481AC000, 0x481AE000 };	/**< Register Bank addresses */
-static uint32_t *mapGPIO[4];	/**< Variable for GPIO memory map */
+volatile uint32_t *mapGPIO[GPIO_BANKS];	/**< Variable for GPIO memory map */
 static int fdGPIO = 0;			/**< File descriptor for GPIO for file system access */
 static int initialized = 0;		/**< Variable to check if GPIO is initialized earlier */
-static int usingMmap = 0;		/**< Variable to check if Memory map access mode for GPIO is set */
+static int accessMode = GPIO_ACCESS_SYSFS;	/**< Access mode picked in openGPIO() */
+static GPIOChip_t chipGPIO[GPIO_BANKS];	/**< Character device state of each bank */
+static int fdValue[MAX_GPIO_ID];	/**< Cached value file descriptors for file system access, -1 if not opened yet */
+static uint32_t shadowOE[GPIO_BANKS];	/**< Shadow of each bank's OE register, a set bit is an input */
+static uint32_t knownOE[GPIO_BANKS];	/**< Bits of shadowOE that hold a known direction */
+
+/**
+ * This function takes GPIO header and pin and returns the GPIOBit_t entry for that pin.
+ * It is shared with the other GPIO modules through gpio_internal.h.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return pointer to the pin information or NULL if the header/pin is not a GPIO.
+ */
+
+const GPIOBit_t *getGPIOPin(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO;
+
+  if ((pin == 0) || (pin > TOTAL_PINS_PER_HEADER))
+    return NULL;
+
+  if (header == 8)
+    pinGPIO = &(P8_GPIO_pin_info[pin - 1]);
+  else if (header == 9)
+    pinGPIO = &(P9_GPIO_pin_info[pin - 1]);
+  else
+    return NULL;
+
+  if (!pinGPIO->mask)
+    return NULL;
+
+  return pinGPIO;
+}
+
+/**
+ * This function tells the other GPIO modules whether the bank registers are memory mapped.
+ * It is shared with the other GPIO modules through gpio_internal.h.
+ * @return 1 if openGPIO() picked memory map access and 0 otherwise.
+ */
+
+int gpioMmapReady(void)
+{
+  return initialized && (accessMode == GPIO_ACCESS_MMAP);
+}
+
+/**
+ * This function sets the OE bits of some lines of a memory mapped bank through the shadow
+ * register, so the other GPIO functions keep seeing the right directions. It writes the
+ * register without reading it back, which keeps it fast enough for bit-banged protocols.
+ * It is shared with the other GPIO modules through gpio_internal.h.
+ * @param bank a constant unsigned int argument.
+ * @param lines a constant uint32_t argument, mask of the lines to change.
+ * @param inputs a constant uint32_t argument, mask of the lines to make inputs, the other lines become outputs.
+ */
+
+void gpioSetOE(const unsigned int bank, const uint32_t lines, const uint32_t inputs)
+{
+  shadowOE[bank] = (shadowOE[bank] & ~lines) | (inputs & lines);
+  knownOE[bank] |= lines;
+  mapGPIO[bank][GPIO_OE_REG/4] = shadowOE[bank];
+}
+
+/**
+ * This function prepares the calling thread for a real-time GPIO loop.
+ * It pins the thread to a CPU and raises it to SCHED_FIFO; failing to get real-time
+ * priority is not an error since the loop still works, only with more jitter.
+ * It is shared with the other GPIO modules through gpio_internal.h.
+ * @param cpu a constant integer argument, CPU to pin the thread to or -1 to leave the affinity unchanged.
+ * @return 0 if successfull and 1 if the thread could not be pinned.
+ */
+
+int gpioRealtimeThread(const int cpu)
+{
+  struct sched_param param;
+  cpu_set_t set;
+
+  if (cpu >= 0) {
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+      return 1;
+  }
+
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+  sched_setscheduler(0, SCHED_FIFO, &param);
+
+  return 0;
+}
+
+/**
+ * This function requests all header lines of a bank that are not used by the kernel or another
+ * process, once, when the character devices are opened. The request is never replaced, since
+ * closing it would release lines being driven and the kernel would turn them back into inputs.
+ * Lines are requested without direction flags so their current direction is kept.
+ * @param bank a constant unsigned int argument.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+static int requestBankCdev(const unsigned int bank)
+{
+  GPIOChip_t *chip = &chipGPIO[bank];
+  struct gpio_v2_line_request req;
+  struct gpio_v2_line_info info;
+  uint32_t lines = 0;
+  int i;
+
+  for (i = 0; i < TOTAL_PINS_PER_HEADER; i++) {
+    if (P8_GPIO_pin_info[i].mask && (P8_GPIO_pin_info[i].bank == bank))
+      lines |= P8_GPIO_pin_info[i].mask;
+    if (P9_GPIO_pin_info[i].mask && (P9_GPIO_pin_info[i].bank == bank))
+      lines |= P9_GPIO_pin_info[i].mask;
+  }
+
+  memset(&req, 0, sizeof(req));
+  strncpy(req.consumer, GPIO_CONSUMER, sizeof(req.consumer) - 1);
+  for (i = 0; i < 32; i++) {
+    if (!(lines & (1u << i)))
+      continue;
+
+    /* Lines claimed elsewhere (eMMC, HDMI, other processes) would fail the whole request */
+    memset(&info, 0, sizeof(info));
+    info.offset = i;
+    if ((ioctl(chip->fdChip, GPIO_V2_GET_LINEINFO_IOCTL, &info) < 0) ||
+        (info.flags & GPIO_V2_LINE_FLAG_USED)) {
+      lines &= ~(1u << i);
+      continue;
+    }
+
+    chip->index[i] = req.num_lines;
+    req.offsets[req.num_lines++] = i;
+  }
+
+  if (req.num_lines == 0)
+    return 0;
+
+  if (ioctl(chip->fdChip, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+    return 1;
+
+  chip->fdLines = req.fd;
+  chip->lines = lines;
+  return 0;
+}
 
 /**
  * This function takes parameter input useMmap
- * to take choice if you want to use Memory Map to access GPIO or to access it using 
- * file system. If using memory map then a proper file descriptor is set.
- * @param useMmap a constant integer argument.
+ * to take choice if you want to use Memory Map to access GPIO, to access it using 
+ * file system or to access it using the GPIO character devices. If using memory map
+ * then a proper file descriptor is set.
+ * @param useMmap a constant integer argument, one of GPIO_ACCESS_SYSFS, GPIO_ACCESS_MMAP and GPIO_ACCESS_CDEV.
  * @return If successful then 0 is returned and if it fails then 1 is returned.
  */
 
@@ -174,21 +340,59 @@ int openGPIO(const int useMmap)
   if (initialized)
     return 1;
 
-  usingMmap = useMmap;
+  if ((useMmap < GPIO_ACCESS_SYSFS) || (useMmap > GPIO_ACCESS_CDEV))
+    return 1;
+
+  accessMode = useMmap;
+
+  /* Value files are opened lazily on first access */
+  for (i = 0; i < MAX_GPIO_ID; i++)
+    fdValue[i] = -1;
+
+  /* Directions are learned as pins are configured */
+  for (i = 0; i < GPIO_BANKS; i++)
+    shadowOE[i] = knownOE[i] = 0;
 
   /* Are we using mmap() for the GPIO access? */
-  if (usingMmap) {
-    fdGPIO = open("/dev/mem", O_RDWR | O_SYNC);
+  if (accessMode == GPIO_ACCESS_MMAP) {
+    fdGPIO = open(GPIO_MEM_DEV, O_RDWR | O_SYNC);
 
     /* mmap() the four GPIO bank registers */
     for (i = 0; i < 4; i++)
     {
-      mapGPIO[i] = (uint32_t *) mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE, MAP_SHARED, fdGPIO, gpioAddrs[i]);
+      mapGPIO[i] = (volatile uint32_t *) mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE, MAP_SHARED, fdGPIO, gpioAddrs[i]);
       /*printf("gpio[%i] at address 0x%08x mapped at 0x%08x\n",i,gpioAddrs[i],(unsigned int)mapGPIO[i]);*/
       if (mapGPIO[i] == (uint32_t *)-1) {
         printf("GPIO: errno[%d]: '%s'\n", errno, strerror(errno));
         return 1;
       }
+
+      /* The OE register holds the direction of every pin in the bank */
+      shadowOE[i] = mapGPIO[i][GPIO_OE_REG/4];
+      knownOE[i] = 0xFFFFFFFF;
+    }
+  }
+
+  /* Are we using the character devices for the GPIO access? */
+  if (accessMode == GPIO_ACCESS_CDEV) {
+    /* Bank N is gpiochipN and the line offset is the bit in the bank */
+    for (i = 0; i < GPIO_BANKS; i++)
+    {
+      snprintf(fsBuf, sizeof(fsBuf), GPIO_CHIP_DEV "%d", i);
+      chipGPIO[i].fdChip = open(fsBuf, O_RDWR);
+      chipGPIO[i].fdLines = -1;
+      chipGPIO[i].lines = 0;
+      if ((chipGPIO[i].fdChip < 0) || requestBankCdev(i)) {
+        printf("GPIO: errno[%d]: '%s'\n", errno, strerror(errno));
+        if (chipGPIO[i].fdChip >= 0)
+          close(chipGPIO[i].fdChip);
+        while (i-- > 0) {
+          if (chipGPIO[i].fdLines >= 0)
+            close(chipGPIO[i].fdLines);
+          close(chipGPIO[i].fdChip);
+        }
+        return 1;
+      }
     }
   }
 
@@ -217,7 +421,9 @@ static int readGPIOMmap(const GPIOBit_t *pinGPIO)
 
 /**
  * This function takes input pointer to GPIOBit_t type structure which stores information about a pin.
- * This pin information is then used to get DATA OUT register and OE register to write to GPIO.
+ * This pin information is then used to write the pin mask to the SET DATA OUT or CLEAR DATA OUT register.
+ * Each write is a single store that only affects the bits in the mask, so there is no read-modify-write
+ * of DATA OUT and writers touching other pins of the same bank cannot lose updates.
  * @param *pinGPIO a constant GPIOBit_t argument.
  * @return 0
  */
@@ -225,24 +431,45 @@ static int readGPIOMmap(const GPIOBit_t *pinGPIO)
 static int writeGPIOMmap(const GPIOBit_t *pinGPIO, 
   const unsigned int value) 
 {
-  unsigned int reg;
+  if (value) /* Set the output bit */
+    mapGPIO[pinGPIO->bank][GPIO_SETDATAOUT_REG/4] = pinGPIO->mask;
+  else /* Clear the output bit */
+    mapGPIO[pinGPIO->bank][GPIO_CLEARDATAOUT_REG/4] = pinGPIO->mask;
 
-  /* Get the appropriate OE register */
-  reg = mapGPIO[pinGPIO->bank][GPIO_DATA_OUT_REG/4];
-  if (value) { /* Set the output bit */
-    /* Set the output bit */
-    reg = reg | pinGPIO->mask;
+  return 0;
+}
 
-    /* Set the appropriate OE register */
-    mapGPIO[pinGPIO->bank][GPIO_DATA_OUT_REG/4] = reg;
-  } else { /* Clear the output bit */
-    /* Clear the output bit */
-    reg = reg & (0xFFFFFFFF - pinGPIO->mask);
+/**
+ * This function takes input pointer to GPIOBit_t type structure which stores information about a pin
+ * and returns the cached file descriptor of its value file, opening it on first use.
+ * The descriptor stays open until closeGPIO() so later accesses skip the path lookup.
+ * @param *pinGPIO a constant GPIOBit_t argument.
+ * @return file descriptor on success and -1 if it fails.
+ */
 
-    /* Set the appropriate OE register */
-    mapGPIO[pinGPIO->bank][GPIO_DATA_OUT_REG/4] = reg;
-  }
-  return 0;
+static int getGPIOValueFD(const GPIOBit_t *pinGPIO)
+{
+  int fd;
+
+  if (pinGPIO->id >= MAX_GPIO_ID)
+    return -1;
+
+  fd = fdValue[pinGPIO->id];
+  if (fd >= 0)
+    return fd;
+
+  snprintf(fsBuf, sizeof(fsBuf), SYSFS_GPIO_DIR "/gpio%d/value",
+    pinGPIO->id);
+
+  /* Input pins may only grant read access to the value file */
+  fd = open(fsBuf, O_RDWR);
+  if (fd < 0)
+    fd = open(fsBuf, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  fdValue[pinGPIO->id] = fd;
+  return fd;
 }
 
 /**
@@ -257,15 +484,12 @@ static int readGPIOFS(const GPIOBit_t *pinGPIO)
   int fd, len;
   char ch;
 
-  snprintf(fsBuf, sizeof(fsBuf), SYSFS_GPIO_DIR "/gpio%d/value",
-    pinGPIO->id);
-
-  fd = open(fsBuf, O_RDONLY);
+  fd = getGPIOValueFD(pinGPIO);
   if (fd < 0)
     return 0;
- 
-  len = read(fd, &ch, 1);
-  close(fd);
+
+  /* sysfs regenerates the attribute on every read from offset 0 */
+  len = pread(fd, &ch, 1, 0);
 
   /* If we were able to read a "1", return 1 */
   if ((len > 0) && (ch != '0'))
@@ -286,26 +510,284 @@ static int writeGPIOFS(const GPIOBit_t *pinGPIO,
 {
   int fd, len;
 
-  snprintf(fsBuf, sizeof(fsBuf), SYSFS_GPIO_DIR "/gpio%d/value", 
-    pinGPIO->id);
-
-  fd = open(fsBuf, O_WRONLY);
-  if (fd < 0) {
+  fd = getGPIOValueFD(pinGPIO);
+  if (fd < 0)
     return 1;
-  }
 
   if (value)
-    len = write(fd, "1", 2);
+    len = pwrite(fd, "1", 1, 0);
   else
-    len = write(fd, "0", 2);
+    len = pwrite(fd, "0", 1, 0);
 
-  if (len < 2)
+  if (len < 1)
     return 1;
 
-  close(fd);
   return 0;
 }
 
+/**
+ * This function checks that the given lines of a bank are part of the bank's line request.
+ * @param bank a constant unsigned int argument.
+ * @param lines a constant uint32_t argument, mask of bank lines.
+ * @return 0 if successfull and 1 if some line could not be requested in openGPIO()
+ */
+
+static int requestLinesCdev(const unsigned int bank, const uint32_t lines)
+{
+  return ((chipGPIO[bank].lines & lines) == lines) ? 0 : 1;
+}
+
+/**
+ * This function converts a mask of bank lines to the matching bits of the bank's line request.
+ * @param chip a constant GPIOChip_t pointer argument.
+ * @param lines a constant uint32_t argument, mask of bank lines.
+ * @return mask of request bits.
+ */
+
+static uint64_t linesToRequestBits(const GPIOChip_t *chip, uint32_t lines)
+{
+  uint64_t bits = 0;
+  int i;
+
+  for (i = 0; lines; i++, lines >>= 1)
+    if (lines & 1)
+      bits |= 1ULL << chip->index[i];
+
+  return bits;
+}
+
+/**
+ * This function reads the given lines of a bank with a single ioctl.
+ * @param bank a constant unsigned int argument.
+ * @param lines a constant uint32_t argument, mask of bank lines.
+ * @param *word a uint32_t pointer argument that receives the values in DATA IN register layout.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+static int readBankCdev(const unsigned int bank, const uint32_t lines, uint32_t *word)
+{
+  GPIOChip_t *chip = &chipGPIO[bank];
+  struct gpio_v2_line_values values;
+  uint32_t result = 0;
+  int i;
+
+  if (requestLinesCdev(bank, lines))
+    return 1;
+
+  values.bits = 0;
+  values.mask = linesToRequestBits(chip, lines);
+  if (ioctl(chip->fdLines, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
+    return 1;
+
+  for (i = 0; i < 32; i++)
+    if ((lines & (1u << i)) && (values.bits & (1ULL << chip->index[i])))
+      result |= 1u << i;
+
+  *word = result;
+  return 0;
+}
+
+/**
+ * This function sets and clears the given lines of a bank with a single ioctl.
+ * @param bank a constant unsigned int argument.
+ * @param set a constant uint32_t argument, mask of bank lines to drive high.
+ * @param clear a constant uint32_t argument, mask of bank lines to drive low.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+static int writeBankCdev(const unsigned int bank, const uint32_t set, const uint32_t clear)
+{
+  GPIOChip_t *chip = &chipGPIO[bank];
+  struct gpio_v2_line_values values;
+
+  if (requestLinesCdev(bank, set | clear))
+    return 1;
+
+  values.bits = linesToRequestBits(chip, set);
+  values.mask = values.bits | linesToRequestBits(chip, clear);
+  if (ioctl(chip->fdLines, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0)
+    return 1;
+
+  return 0;
+}
+
+/**
+ * This function takes input pointer to GPIOBit_t type structure which stores information about a pin.
+ * This pin information is then used to read the line from the bank's character device line request.
+ * @param *pinGPIO a constant GPIOBit_t argument.
+ * @return 1 if read 1 and 0 if read 0;
+ */
+
+static int readGPIOCdev(const GPIOBit_t *pinGPIO)
+{
+  uint32_t word;
+
+  if (readBankCdev(pinGPIO->bank, pinGPIO->mask, &word))
+    return 0;
+
+  return (word & pinGPIO->mask) ? 1 : 0;
+}
+
+/**
+ * This function takes input pointer to GPIOBit_t type structure which stores information about a pin.
+ * This pin information is then used to write the line through the bank's character device line request.
+ * @param *pinGPIO a constant GPIOBit_t argument.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+static int writeGPIOCdev(const GPIOBit_t *pinGPIO,
+  const unsigned int value)
+{
+  if (value)
+    return writeBankCdev(pinGPIO->bank, pinGPIO->mask, 0);
+  else
+    return writeBankCdev(pinGPIO->bank, 0, pinGPIO->mask);
+}
+
+/**
+ * This function sets the direction of a set of lines of one bank with the access method picked in openGPIO().
+ * Lines whose direction is already known from the shadow OE copy are skipped, so repeated
+ * configuration costs no syscall or register access. Using memory map the bank's OE register
+ * is written with a single store, using the character devices the bank's line request gets a
+ * single configuration ioctl and using file system each line's direction file is written.
+ * @param bank a constant unsigned int argument.
+ * @param lines a constant uint32_t argument, mask of bank lines to configure.
+ * @param outputs a constant uint32_t argument, mask of bank lines that become outputs.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+static int setBankDirection(const unsigned int bank, uint32_t lines, const uint32_t outputs)
+{
+  struct gpio_v2_line_config config;
+  uint32_t inputs = lines & ~outputs;
+  uint32_t done = 0;
+  FILE *fd;
+  int i, ret = 0, len;
+
+  /* Drop lines whose direction would not change */
+  lines &= ~knownOE[bank] | (shadowOE[bank] ^ inputs);
+  if (!lines)
+    return 0;
+
+  if (accessMode == GPIO_ACCESS_MMAP) {
+    /* A set OE bit makes the pin an input */
+    mapGPIO[bank][GPIO_OE_REG/4] = (shadowOE[bank] & ~lines) | (inputs & lines);
+  } else if (accessMode == GPIO_ACCESS_CDEV) {
+    if (requestLinesCdev(bank, lines))
+      return 1;
+
+    /* Lines without a direction attribute keep their current direction */
+    memset(&config, 0, sizeof(config));
+    if (inputs & lines) {
+      config.attrs[config.num_attrs].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+      config.attrs[config.num_attrs].attr.flags = GPIO_V2_LINE_FLAG_INPUT;
+      config.attrs[config.num_attrs].mask = linesToRequestBits(&chipGPIO[bank], inputs & lines);
+      config.num_attrs++;
+    }
+    if (outputs & lines) {
+      config.attrs[config.num_attrs].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+      config.attrs[config.num_attrs].attr.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+      config.attrs[config.num_attrs].mask = linesToRequestBits(&chipGPIO[bank], outputs & lines);
+      config.num_attrs++;
+    }
+
+    if (ioctl(chipGPIO[bank].fdLines, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0)
+      return 1;
+  } else {
+    for (i = 0; i < 32; i++) {
+      if (!(lines & (1u << i)))
+        continue;
+
+      snprintf(fsBuf, sizeof(fsBuf), SYSFS_GPIO_DIR "/gpio%d/direction", bank * 32 + i);
+
+      fd = fopen(fsBuf, "w");
+      if (fd == NULL) {
+        ret = 1;
+        break;
+      }
+
+      /* The write only reaches the kernel when the file is closed */
+      len = fprintf(fd, "%s", (outputs & (1u << i)) ? "out" : "in");
+      if ((fclose(fd) != 0) || (len <= 0)) {
+        ret = 1;
+        break;
+      }
+      done |= 1u << i;
+    }
+
+    /* Lines whose direction write failed keep an unknown direction */
+    lines = done;
+  }
+
+  shadowOE[bank] = (shadowOE[bank] & ~lines) | (inputs & lines);
+  knownOE[bank] |= lines;
+
+  return ret;
+}
+
+/**
+ * This function takes input pointer to GPIOBit_t type structure which stores information about a pin
+ * and sets the direction of the pin with the access method picked in openGPIO().
+ * @param *pinGPIO a constant GPIOBit_t argument.
+ * @param direction a constant integer argument, GPIO_DIRECTION_INPUT or GPIO_DIRECTION_OUTPUT.
+ * @see setBankDirection()
+ * @return 0 if successfull and 1 if it fails
+ */
+
+static int setGPIODirection(const GPIOBit_t *pinGPIO, const int direction)
+{
+  return setBankDirection(pinGPIO->bank, pinGPIO->mask,
+    (direction == GPIO_DIRECTION_OUTPUT) ? pinGPIO->mask : 0);
+}
+
+/**
+ * This function takes input pointer to GPIOBit_t type structure which stores information about a pin
+ * and returns its direction. The shadow OE copy is used when the direction is known, otherwise
+ * the direction is read once from the file system or the character device and remembered.
+ * @param *pinGPIO a constant GPIOBit_t argument.
+ * @return GPIO_DIRECTION_INPUT, GPIO_DIRECTION_OUTPUT or -1 if it fails.
+ */
+
+static int getGPIODirection(const GPIOBit_t *pinGPIO)
+{
+  struct gpio_v2_line_info info;
+  char dir[4];
+  FILE *fd;
+  int output;
+
+  if (knownOE[pinGPIO->bank] & pinGPIO->mask)
+    return (shadowOE[pinGPIO->bank] & pinGPIO->mask) ? GPIO_DIRECTION_INPUT : GPIO_DIRECTION_OUTPUT;
+
+  if (accessMode == GPIO_ACCESS_CDEV) {
+    memset(&info, 0, sizeof(info));
+    info.offset = pinGPIO->id % 32;
+    if (ioctl(chipGPIO[pinGPIO->bank].fdChip, GPIO_V2_GET_LINEINFO_IOCTL, &info) < 0)
+      return -1;
+    output = (info.flags & GPIO_V2_LINE_FLAG_OUTPUT) != 0;
+  } else {
+    snprintf(fsBuf, sizeof(fsBuf), SYSFS_GPIO_DIR "/gpio%d/direction", pinGPIO->id);
+
+    fd = fopen(fsBuf, "r");
+    if (fd == NULL)
+      return -1;
+
+    if (fscanf(fd, "%3s", dir) != 1) {
+      fclose(fd);
+      return -1;
+    }
+    fclose(fd);
+    output = (strcmp(dir, "out") == 0);
+  }
+
+  if (output)
+    shadowOE[pinGPIO->bank] &= ~pinGPIO->mask;
+  else
+    shadowOE[pinGPIO->bank] |= pinGPIO->mask;
+  knownOE[pinGPIO->bank] |= pinGPIO->mask;
+
+  return output ? GPIO_DIRECTION_OUTPUT : GPIO_DIRECTION_INPUT;
+}
+
 /**
  * It takes input GPIO header and pin and reads its value after opening its file.
  * If Memory Map is used then proper bit value is read using the file descriptor initialized in openGPIO() function call.
@@ -313,6 +795,7 @@ static int writeGPIOFS(const GPIOBit_t *pinGPIO,
  * @param header a constant unsigned int argument.
  * @param pin a constant unsigned int argument.
  * @see readGPIOMmap()
+ * @see readGPIOCdev()
  * @see readGPIOFS()
  * @return 1 if read 1 and 0 if read 0;
  */
@@ -338,8 +821,10 @@ int readGPIO(const unsigned int header, const unsigned int pin)
     /* Is this pin not a GPIO? */
     if (!pinGPIO->mask) return 0;
 
-    if (usingMmap)
+    if (accessMode == GPIO_ACCESS_MMAP)
       return readGPIOMmap(pinGPIO);
+    else if (accessMode == GPIO_ACCESS_CDEV)
+      return readGPIOCdev(pinGPIO);
     else
       return readGPIOFS(pinGPIO);
   } 
@@ -354,6 +839,7 @@ int readGPIO(const unsigned int header, const unsigned int pin)
  * @param header a constant unsigned int argument.
  * @param pin a constant unsigned int argument.
  * @see writeGPIOMmap()
+ * @see writeGPIOCdev()
  * @see writeGPIOFS()
  * @return 0 if successfull and 1 if it fails
  */
@@ -380,8 +866,13 @@ int writeGPIO(const unsigned int header, const unsigned int pin,
     /* Is this pin not a GPIO? */
     if (!pinGPIO->mask) return 1;
 
-    if (usingMmap)
+    /* Is this pin known to be an input? */
+    if (knownOE[pinGPIO->bank] & shadowOE[pinGPIO->bank] & pinGPIO->mask) return 1;
+
+    if (accessMode == GPIO_ACCESS_MMAP)
       return writeGPIOMmap(pinGPIO, value);
+    else if (accessMode == GPIO_ACCESS_CDEV)
+      return writeGPIOCdev(pinGPIO, value);
     else
       return writeGPIOFS(pinGPIO, value);
   } 
@@ -390,13 +881,400 @@ int writeGPIO(const unsigned int header, const unsigned int pin,
 }
 
 /**
- * For closing file descriptor if accessed using file system and set initialized to 0.
+ * For closing file descriptor if accessed using memory map, closing any cached value file descriptors
+ * if accessed using file system, releasing the line requests if accessed using the character devices
+ * and set initialized to 0.
  */
 
 void closeGPIO(void) {
-  if (initialized)
-    if (usingMmap)
+  int i;
+
+  if (initialized) {
+    if (accessMode == GPIO_ACCESS_MMAP)
       close(fdGPIO);
+
+    if (accessMode == GPIO_ACCESS_CDEV) {
+      for (i = 0; i < GPIO_BANKS; i++) {
+        if (chipGPIO[i].fdLines >= 0)
+          close(chipGPIO[i].fdLines);
+        close(chipGPIO[i].fdChip);
+      }
+    }
+
+    for (i = 0; i < MAX_GPIO_ID; i++) {
+      if (fdValue[i] >= 0) {
+        close(fdValue[i]);
+        fdValue[i] = -1;
+      }
+    }
+  }
   initialized = 0;
 }
 
+/**
+ * It takes GPIO header, pin and direction and sets the direction of the pin.
+ * Setting the direction a pin already has costs no syscall or register access.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param direction a constant integer argument, GPIO_DIRECTION_INPUT or GPIO_DIRECTION_OUTPUT.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+int gpioSetDirection(const unsigned int header, const unsigned int pin,
+  const int direction)
+{
+  const GPIOBit_t *pinGPIO;
+
+  if (!initialized)
+    return 1;
+
+  if ((direction != GPIO_DIRECTION_INPUT) && (direction != GPIO_DIRECTION_OUTPUT))
+    return 1;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if (pinGPIO == NULL)
+    return 1;
+
+  return setGPIODirection(pinGPIO, direction);
+}
+
+/**
+ * It takes GPIO header and pin and returns the direction of the pin.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return GPIO_DIRECTION_INPUT, GPIO_DIRECTION_OUTPUT or -1 if it fails.
+ */
+
+int gpioGetDirection(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO;
+
+  if (!initialized)
+    return -1;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if (pinGPIO == NULL)
+    return -1;
+
+  return getGPIODirection(pinGPIO);
+}
+
+/**
+ * It takes GPIO header and pin and returns the register bank and bit mask of the pin,
+ * for building bank masks such as the steps of gpioWaveformCreate().
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param *bank an unsigned int pointer argument that receives the bank, 0 to 3.
+ * @param *mask a uint32_t pointer argument that receives the bit of the pin in the bank.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+int gpioPinMask(const unsigned int header, const unsigned int pin,
+  unsigned int *bank, uint32_t *mask)
+{
+  const GPIOBit_t *pinGPIO;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if (pinGPIO == NULL)
+    return 1;
+
+  *bank = pinGPIO->bank;
+  *mask = pinGPIO->mask;
+  return 0;
+}
+
+/**
+ * This function returns the plan bits of the pins whose direction is known to be input.
+ * @param plan a constant GPIOPlan_t pointer argument.
+ * @return mask of plan bits.
+ */
+
+static uint32_t planInputs(const GPIOPlan_t *plan)
+{
+  uint32_t inputs = 0;
+  int i;
+
+  for (i = 0; i < plan->count; i++)
+    if (knownOE[plan->pins[i]->bank] & shadowOE[plan->pins[i]->bank] & plan->pins[i]->mask)
+      inputs |= 1u << i;
+
+  return inputs;
+}
+
+/**
+ * It takes arrays of GPIO headers and pins and builds a plan for accessing all of them together.
+ * The pins are grouped by register bank once here so that gpioReadMask() and gpioWriteMask()
+ * only need one register access per bank instead of one per pin. Pins known to be inputs
+ * here or after gpioSetDirectionMask() make gpioWriteMask() fail, so checking costs no time per write.
+ * @param headers a constant unsigned int array argument.
+ * @param pins a constant unsigned int array argument.
+ * @param count a constant integer argument, at most 32.
+ * @see gpioReadMask()
+ * @see gpioWriteMask()
+ * @return pointer to the plan on success and NULL if it fails.
+ */
+
+GPIOPlan_t *gpioPlanCreate(const unsigned int headers[], const unsigned int pins[],
+  const int count)
+{
+  GPIOPlan_t *plan;
+  const GPIOBit_t *pinGPIO;
+  int i;
+
+  if ((count <= 0) || (count > MAX_PLAN_PINS))
+    return NULL;
+
+  plan = (GPIOPlan_t *) calloc(1, sizeof(GPIOPlan_t));
+  if (plan == NULL)
+    return NULL;
+
+  for (i = 0; i < count; i++) {
+    pinGPIO = getGPIOPin(headers[i], pins[i]);
+    if (pinGPIO == NULL) {
+      free(plan);
+      return NULL;
+    }
+
+    plan->pins[i] = pinGPIO;
+    plan->bankMask[pinGPIO->bank] |= pinGPIO->mask;
+  }
+  plan->count = count;
+  plan->inputs = planInputs(plan);
+
+  return plan;
+}
+
+/**
+ * It takes a plan created by gpioPlanCreate() and reads all of its pins.
+ * Using memory map each bank's DATA IN register is read at most once and using the
+ * character devices each bank is read with a single ioctl.
+ * @param plan a constant GPIOPlan_t pointer argument.
+ * @param values a uint32_t pointer argument that receives bit i set if pin i of the plan reads 1.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+int gpioReadMask(const GPIOPlan_t *plan, uint32_t *values)
+{
+  unsigned int reg[GPIO_BANKS];
+  uint32_t result = 0;
+  int i;
+
+  if (!initialized || (plan == NULL))
+    return 1;
+
+  if (accessMode != GPIO_ACCESS_SYSFS) {
+    for (i = 0; i < GPIO_BANKS; i++) {
+      if (!plan->bankMask[i])
+        continue;
+      if (accessMode == GPIO_ACCESS_MMAP)
+        reg[i] = mapGPIO[i][GPIO_DATA_IN_REG/4];
+      else if (readBankCdev(i, plan->bankMask[i], &reg[i]))
+        return 1;
+    }
+
+    for (i = 0; i < plan->count; i++)
+      if (reg[plan->pins[i]->bank] & plan->pins[i]->mask)
+        result |= 1u << i;
+  } else {
+    for (i = 0; i < plan->count; i++)
+      if (readGPIOFS(plan->pins[i]))
+        result |= 1u << i;
+  }
+
+  *values = result;
+  return 0;
+}
+
+/**
+ * It takes a plan created by gpioPlanCreate() and writes all of its pins.
+ * Using memory map each bank gets at most one SET DATA OUT and one CLEAR DATA OUT store and
+ * using the character devices each bank is written with a single ioctl.
+ * @param plan a constant GPIOPlan_t pointer argument.
+ * @param values a constant uint32_t argument where bit i is the value for pin i of the plan.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+int gpioWriteMask(const GPIOPlan_t *plan, const uint32_t values)
+{
+  unsigned int set[GPIO_BANKS] = { 0, 0, 0, 0 };
+  unsigned int clear[GPIO_BANKS] = { 0, 0, 0, 0 };
+  int i, ret = 0;
+
+  /* Like writeGPIO(), a plan with pins known to be inputs is not written */
+  if (!initialized || (plan == NULL) || plan->inputs)
+    return 1;
+
+  if (accessMode != GPIO_ACCESS_SYSFS) {
+    for (i = 0; i < plan->count; i++) {
+      if (values & (1u << i))
+        set[plan->pins[i]->bank] |= plan->pins[i]->mask;
+      else
+        clear[plan->pins[i]->bank] |= plan->pins[i]->mask;
+    }
+
+    for (i = 0; i < GPIO_BANKS; i++) {
+      if (accessMode == GPIO_ACCESS_CDEV) {
+        if (set[i] | clear[i])
+          ret |= writeBankCdev(i, set[i], clear[i]);
+        continue;
+      }
+      if (set[i])
+        mapGPIO[i][GPIO_SETDATAOUT_REG/4] = set[i];
+      if (clear[i])
+        mapGPIO[i][GPIO_CLEARDATAOUT_REG/4] = clear[i];
+    }
+  } else {
+    for (i = 0; i < plan->count; i++)
+      ret |= writeGPIOFS(plan->pins[i], values & (1u << i));
+  }
+
+  return ret;
+}
+
+/**
+ * It takes a plan created by gpioPlanCreate() and sets the direction of all of its pins.
+ * Using memory map each bank's OE register is written at most once.
+ * @param plan a GPIOPlan_t pointer argument.
+ * @param outputs a constant uint32_t argument where bit i set makes pin i of the plan an output.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+int gpioSetDirectionMask(GPIOPlan_t *plan, const uint32_t outputs)
+{
+  uint32_t out[GPIO_BANKS] = { 0, 0, 0, 0 };
+  int i, ret = 0;
+
+  if (!initialized || (plan == NULL))
+    return 1;
+
+  for (i = 0; i < plan->count; i++)
+    if (outputs & (1u << i))
+      out[plan->pins[i]->bank] |= plan->pins[i]->mask;
+
+  for (i = 0; i < GPIO_BANKS; i++)
+    if (plan->bankMask[i])
+      ret |= setBankDirection(i, plan->bankMask[i], out[i]);
+
+  plan->inputs = planInputs(plan);
+  return ret;
+}
+
+/**
+ * For freeing a plan created by gpioPlanCreate().
+ * @param plan a GPIOPlan_t pointer argument.
+ */
+
+void gpioPlanFree(GPIOPlan_t *plan)
+{
+  free(plan);
+}
+
+/**
+ * It takes GPIO header, pin and direction and returns a handle to the pin.
+ * The pin lookup, validation and access method selection are done once here so that
+ * gpioPinRead(), gpioPinWrite() and gpioPinToggle() only do the register access.
+ * Using memory map the handle holds the DATA IN, SET DATA OUT and CLEAR DATA OUT register
+ * pointers and each access is a single load or store. A pin known to be an input here gets no
+ * SET and CLEAR DATA OUT pointers, so its writes take the slow path, which refuses them.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param direction a constant integer argument, GPIO_DIRECTION_INPUT, GPIO_DIRECTION_OUTPUT or GPIO_DIRECTION_KEEP.
+ * @see gpioRelease()
+ * @return pointer to the handle on success and NULL if it fails.
+ */
+
+GPIOPin_t *gpioAcquire(const unsigned int header, const unsigned int pin,
+  const int direction)
+{
+  const GPIOBit_t *pinGPIO;
+  GPIOPin_t *handle;
+
+  if (!initialized)
+    return NULL;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if (pinGPIO == NULL)
+    return NULL;
+
+  if ((direction != GPIO_DIRECTION_KEEP) && setGPIODirection(pinGPIO, direction))
+    return NULL;
+
+  handle = (GPIOPin_t *) calloc(1, sizeof(GPIOPin_t));
+  if (handle == NULL)
+    return NULL;
+
+  handle->mask = pinGPIO->mask;
+  handle->pinInfo = pinGPIO;
+
+  if (accessMode == GPIO_ACCESS_MMAP) {
+    handle->dataIn = &mapGPIO[pinGPIO->bank][GPIO_DATA_IN_REG/4];
+    /* Writes to a pin known to be an input take the slow path, which refuses them */
+    if (!(knownOE[pinGPIO->bank] & shadowOE[pinGPIO->bank] & pinGPIO->mask)) {
+      handle->setOut = &mapGPIO[pinGPIO->bank][GPIO_SETDATAOUT_REG/4];
+      handle->clearOut = &mapGPIO[pinGPIO->bank][GPIO_CLEARDATAOUT_REG/4];
+    }
+    handle->state = mapGPIO[pinGPIO->bank][GPIO_DATA_OUT_REG/4] & pinGPIO->mask;
+  } else if (accessMode == GPIO_ACCESS_CDEV) {
+    handle->state = readGPIOCdev(pinGPIO) ? pinGPIO->mask : 0;
+  } else {
+    /* Open the value file now rather than on the first access */
+    if (getGPIOValueFD(pinGPIO) < 0) {
+      free(handle);
+      return NULL;
+    }
+    handle->state = readGPIOFS(pinGPIO) ? pinGPIO->mask : 0;
+  }
+
+  return handle;
+}
+
+/**
+ * It reads a pin whose handle has no register mapping, using the file system or character device access.
+ * It is the slow path of gpioPinRead().
+ * @param handle a constant GPIOPin_t pointer argument.
+ * @return 1 if read 1 and 0 if read 0;
+ */
+
+int gpioPinReadSlow(const GPIOPin_t *handle)
+{
+  const GPIOBit_t *pinGPIO = (const GPIOBit_t *) handle->pinInfo;
+
+  if (accessMode == GPIO_ACCESS_CDEV)
+    return readGPIOCdev(pinGPIO);
+
+  return readGPIOFS(pinGPIO);
+}
+
+/**
+ * It writes a pin whose handle has no register mapping, using the file system or character device access,
+ * or a memory mapped pin that was an input when acquired. Like writeGPIO(), pins known to be inputs
+ * are not written. It is the slow path of gpioPinWrite() and gpioPinToggle().
+ * @param handle a constant GPIOPin_t pointer argument.
+ * @param value a constant unsigned int argument.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+int gpioPinWriteSlow(const GPIOPin_t *handle, const unsigned int value)
+{
+  const GPIOBit_t *pinGPIO = (const GPIOBit_t *) handle->pinInfo;
+
+  if (knownOE[pinGPIO->bank] & shadowOE[pinGPIO->bank] & pinGPIO->mask)
+    return 1;
+
+  if (accessMode == GPIO_ACCESS_MMAP)
+    return writeGPIOMmap(pinGPIO, value);
+  else if (accessMode == GPIO_ACCESS_CDEV)
+    return writeGPIOCdev(pinGPIO, value);
+
+  return writeGPIOFS(pinGPIO, value);
+}
+
+/**
+ * For freeing a handle returned by gpioAcquire().
+ * @param handle a GPIOPin_t pointer argument.
+ */
+
+void gpioRelease(GPIOPin_t *handle)
+{
+  free(handle);
+}
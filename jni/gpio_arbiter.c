@@ -0,0 +1,735 @@
+/**********************************************************
+  GPIO arbitration code letting several processes share
+    the mmap() GPIO access of one daemon
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_arbiter.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief GPIO arbitration code letting several processes share the mmap() GPIO access of one daemon
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/**< Needed for the peer credentials of unix sockets */
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_ARBITER_CLIENTS  16			/**< Maximum number of client processes at once */
+#define ARBITER_RING_SIZE    64			/**< Commands in each client ring, must be a power of two */
+#define ARBITER_SPIN_NS      2000000	/**< Time the daemon keeps polling after the last command before it sleeps */
+#define ARBITER_CHECK_NS     10000000	/**< Longest time a busy daemon goes without looking at its sockets */
+#define ARBITER_REAP_MS      1000		/**< Longest sleep of the daemon */
+#define ARBITER_TIMEOUT_NS   100000000	/**< Time a client waits for the result of a command */
+#define ARBITER_SPIN_LOOPS   100		/**< Polls of a waiting client before it starts yielding the CPU */
+#define ARBITER_RING_TEMP    "/data/local/tmp/bbbgpio_ring_XXXXXX"	/**< Ring file template when memfd_create() is missing */
+
+#define ARBITER_CMD_CLAIM     0	/**< Take ownership of a free pin */
+#define ARBITER_CMD_RELEASE   1	/**< Give up ownership of a pin */
+#define ARBITER_CMD_DIRECTION 2	/**< Set the direction of an owned pin */
+#define ARBITER_CMD_WRITE     3	/**< Write an owned pin */
+#define ARBITER_CMD_READ      4	/**< Read an owned pin */
+
+/**
+ * typedef struct GPIOArbiterCmd_t for one command in a client ring.
+ */
+
+typedef struct {
+  uint8_t op;        /**< One of the ARBITER_CMD_ values */
+  uint8_t header;    /**< Header of the pin */
+  uint8_t pin;       /**< Pin of the pin */
+  uint8_t value;     /**< Value or direction */
+  int32_t result;    /**< Result written by the daemon, -1 on failure */
+} GPIOArbiterCmd_t;
+
+/**
+ * typedef struct GPIOArbiterRing_t for the command ring shared by the daemon and one client.
+ * Each ring lives in its own file created by the daemon with mode 0600 and handed to the
+ * client over the socket, so no other process can map it. The client only writes head and
+ * the commands, the daemon only writes tail, sleeping and the results, and checks everything
+ * it reads from the ring since the client may not be trusted.
+ */
+
+typedef struct {
+  uint32_t head;                                /**< Commands posted by the client */
+  uint32_t tail;                                /**< Commands completed by the daemon */
+  uint32_t sleeping;                            /**< Non zero while the daemon waits on its sockets */
+  GPIOArbiterCmd_t ring[ARBITER_RING_SIZE];     /**< Commands */
+} GPIOArbiterRing_t;
+
+/**
+ * typedef struct GPIOArbiterClient_t for the daemon's private state of one client.
+ */
+
+typedef struct {
+  int fd;                     /**< Connected socket, -1 if the slot is free */
+  pid_t pid;                  /**< Process id from the peer credentials */
+  GPIOArbiterRing_t *ring;    /**< Mapped ring of the client */
+} GPIOArbiterClient_t;
+
+/* Daemon state, never shared with the clients */
+static GPIOArbiterClient_t clients[MAX_ARBITER_CLIENTS];	/**< Connected clients */
+static uint8_t owner[MAX_GPIO_ID];	/**< Client slot + 1 owning each GPIO id, 0 if free */
+static int fdListen = -1;	/**< Listening socket of the daemon */
+static int allowedUid = -1;	/**< User id allowed besides root, -1 for none */
+static int allowedGid = -1;	/**< Group allowed besides root, -1 for none */
+static volatile int arbiterRunning = 0;	/**< Cleared to stop gpioArbiterServe() */
+
+/* Client state */
+static int fdServer = -1;	/**< Socket connected to the daemon */
+static GPIOArbiterRing_t *clientRing = NULL;	/**< Ring of this process when connected as a client */
+static uint32_t owned[MAX_GPIO_ID / 32];	/**< Pins this process claimed, checked before queueing writes */
+
+/**
+ * This function fills the socket address of the daemon.
+ * @param addr a sockaddr_un pointer argument.
+ */
+
+static void arbiterAddress(struct sockaddr_un *addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  strncpy(addr->sun_path, GPIO_ARBITER_PATH, sizeof(addr->sun_path) - 1);
+}
+
+/**
+ * This function creates the file of a new ring, readable and writable by the daemon only.
+ * @return file descriptor of the ring file and -1 if it fails.
+ */
+
+static int createRing(void)
+{
+  char path[] = ARBITER_RING_TEMP;
+  int fd = -1;
+
+#ifdef __NR_memfd_create
+  fd = syscall(__NR_memfd_create, "bbbgpio_ring", 0);
+#endif
+
+  /* Older kernels have no memfd, an unlinked 0600 file works the same */
+  if (fd < 0) {
+    fd = mkstemp(path);
+    if (fd < 0)
+      return -1;
+    unlink(path);
+  }
+
+  if ((fchmod(fd, 0600) < 0) || (ftruncate(fd, sizeof(GPIOArbiterRing_t)) < 0)) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/**
+ * This function runs one command for a client in the daemon. The command was copied out
+ * of the ring first, so the client cannot change it while it is checked.
+ * @param slot a constant integer argument, slot of the client.
+ * @param cmd a GPIOArbiterCmd_t pointer argument.
+ * @return result of the command.
+ */
+
+static int32_t serveCommand(const int slot, const GPIOArbiterCmd_t *cmd)
+{
+  const GPIOBit_t *pinGPIO;
+
+  pinGPIO = getGPIOPin(cmd->header, cmd->pin);
+  if (pinGPIO == NULL)
+    return -1;
+
+  if (cmd->op == ARBITER_CMD_CLAIM) {
+    if ((owner[pinGPIO->id] != 0) && (owner[pinGPIO->id] != slot + 1))
+      return -1;
+    owner[pinGPIO->id] = slot + 1;
+    return 0;
+  }
+
+  if (owner[pinGPIO->id] != slot + 1)
+    return -1;
+
+  switch (cmd->op) {
+  case ARBITER_CMD_RELEASE:
+    owner[pinGPIO->id] = 0;
+    return 0;
+  case ARBITER_CMD_DIRECTION:
+    if ((cmd->value != GPIO_DIRECTION_INPUT) && (cmd->value != GPIO_DIRECTION_OUTPUT))
+      return -1;
+    return gpioSetDirection(cmd->header, cmd->pin, cmd->value) ? -1 : 0;
+  case ARBITER_CMD_WRITE:
+    if (cmd->value)
+      mapGPIO[pinGPIO->bank][GPIO_SETDATAOUT_REG/4] = pinGPIO->mask;
+    else
+      mapGPIO[pinGPIO->bank][GPIO_CLEARDATAOUT_REG/4] = pinGPIO->mask;
+    return 0;
+  case ARBITER_CMD_READ:
+    return (mapGPIO[pinGPIO->bank][GPIO_DATA_IN_REG/4] & pinGPIO->mask) != 0;
+  }
+
+  return -1;
+}
+
+/**
+ * This function disconnects a client in the daemon and frees the pins it owned.
+ * @param slot a constant integer argument.
+ */
+
+static void dropClient(const int slot)
+{
+  GPIOArbiterClient_t *client = &clients[slot];
+  int id;
+
+  for (id = 0; id < MAX_GPIO_ID; id++)
+    if (owner[id] == slot + 1)
+      owner[id] = 0;
+
+  munmap(client->ring, sizeof(GPIOArbiterRing_t));
+  close(client->fd);
+  client->ring = NULL;
+  client->fd = -1;
+}
+
+/**
+ * This function accepts a client connection in the daemon. The peer credentials are checked,
+ * a private ring is created and its file descriptor is sent to the client together with a
+ * status byte, 0 if the client was accepted.
+ */
+
+static void acceptClient(void)
+{
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char control[CMSG_SPACE(sizeof(int))];
+  char status = 1;
+  void *map;
+  int fd, fdRing, slot;
+
+  fd = accept(fdListen, NULL, NULL);
+  if (fd < 0)
+    return;
+
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+    goto refuse;
+  /* Group members passed the permissions of the socket, which include supplementary groups */
+  if ((cred.uid != 0) && ((allowedUid < 0) || (cred.uid != (uid_t) allowedUid)) && (allowedGid < 0))
+    goto refuse;
+
+  /* One slot per process */
+  for (slot = 0; slot < MAX_ARBITER_CLIENTS; slot++)
+    if ((clients[slot].fd >= 0) && (clients[slot].pid == cred.pid))
+      goto refuse;
+
+  for (slot = 0; slot < MAX_ARBITER_CLIENTS; slot++)
+    if (clients[slot].fd < 0)
+      break;
+  if (slot == MAX_ARBITER_CLIENTS)
+    goto refuse;
+
+  fdRing = createRing();
+  if (fdRing < 0)
+    goto refuse;
+
+  map = mmap(NULL, sizeof(GPIOArbiterRing_t), PROT_READ | PROT_WRITE, MAP_SHARED, fdRing, 0);
+  if (map == MAP_FAILED) {
+    close(fdRing);
+    goto refuse;
+  }
+
+  memset(&msg, 0, sizeof(msg));
+  status = 0;
+  iov.iov_base = &status;
+  iov.iov_len = 1;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fdRing, sizeof(int));
+
+  if (sendmsg(fd, &msg, MSG_NOSIGNAL) != 1) {
+    munmap(map, sizeof(GPIOArbiterRing_t));
+    close(fdRing);
+    close(fd);
+    return;
+  }
+  close(fdRing);
+
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  clients[slot].fd = fd;
+  clients[slot].pid = cred.pid;
+  clients[slot].ring = (GPIOArbiterRing_t *) map;
+  return;
+
+refuse:
+  status = 1;
+  send(fd, &status, 1, MSG_NOSIGNAL);
+  close(fd);
+}
+
+/**
+ * This function waits for activity on the daemon's sockets: new clients, clients going away
+ * and wake up bytes sent by clients that posted a command while the daemon was sleeping.
+ * @param timeout_ms a constant integer argument, passed to poll().
+ */
+
+static void serveSockets(const int timeout_ms)
+{
+  struct pollfd fds[MAX_ARBITER_CLIENTS + 1];
+  int slots[MAX_ARBITER_CLIENTS + 1];
+  char buf[64];
+  int slot, n = 0, i, len;
+
+  fds[n].fd = fdListen;
+  fds[n].events = POLLIN;
+  slots[n++] = -1;
+  for (slot = 0; slot < MAX_ARBITER_CLIENTS; slot++) {
+    if (clients[slot].fd < 0)
+      continue;
+    fds[n].fd = clients[slot].fd;
+    fds[n].events = POLLIN;
+    slots[n++] = slot;
+  }
+
+  if (poll(fds, n, timeout_ms) <= 0)
+    return;
+
+  for (i = 1; i < n; i++) {
+    if (!fds[i].revents)
+      continue;
+
+    /* Anything but wake up bytes, including end of file, ends the client */
+    len = read(fds[i].fd, buf, sizeof(buf));
+    if ((len <= 0) && !((len < 0) && (errno == EAGAIN)))
+      dropClient(slots[i]);
+  }
+
+  if (fds[0].revents & POLLIN)
+    acceptClient();
+}
+
+/**
+ * This function serves the posted commands of all clients.
+ * @return non zero if any command was served.
+ */
+
+static int serveRings(void)
+{
+  GPIOArbiterRing_t *ring;
+  GPIOArbiterCmd_t cmd;
+  uint32_t head, tail;
+  int slot, work = 0;
+
+  for (slot = 0; slot < MAX_ARBITER_CLIENTS; slot++) {
+    if (clients[slot].fd < 0)
+      continue;
+    ring = clients[slot].ring;
+
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    tail = ring->tail;
+    if (head - tail > ARBITER_RING_SIZE) {
+      dropClient(slot);
+      continue;
+    }
+
+    while (tail != head) {
+      memcpy(&cmd, &ring->ring[tail & (ARBITER_RING_SIZE - 1)], sizeof(cmd));
+      ring->ring[tail & (ARBITER_RING_SIZE - 1)].result = serveCommand(slot, &cmd);
+      __atomic_store_n(&ring->tail, ++tail, __ATOMIC_RELEASE);
+      work = 1;
+    }
+  }
+
+  return work;
+}
+
+/**
+ * This function announces to every client whether the daemon sleeps.
+ * @param sleeping a constant integer argument.
+ */
+
+static void setSleeping(const int sleeping)
+{
+  int slot;
+
+  for (slot = 0; slot < MAX_ARBITER_CLIENTS; slot++)
+    if (clients[slot].fd >= 0)
+      __atomic_store_n(&clients[slot].ring->sleeping, sleeping, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * It runs the arbitration daemon until gpioArbiterShutdown() is called. Clients connect to the
+ * unix socket GPIO_ARBITER_PATH and each get a private command ring, so only the daemon needs
+ * access to /dev/mem and only the daemon knows who owns which pin. GPIO has to be opened with
+ * memory map access. The daemon refuses to start while another daemon answers on the socket.
+ * The daemon polls the rings while commands keep coming, yielding the CPU between polls, and
+ * sleeps on its sockets once they stop, so clients only make a system call to wake up an idle daemon.
+ * Only root may connect unless a user or a group is given. The socket is owned by them and
+ * not accessible to anybody else.
+ * @param uid a constant integer argument, user id allowed to connect besides root or -1 for none.
+ * @param gid a constant integer argument, group allowed to connect besides root or -1 for none.
+ * @return 0 when stopped and -1 if it fails.
+ */
+
+int gpioArbiterServe(const int uid, const int gid)
+{
+  struct sockaddr_un addr;
+  uint64_t now, lastWork, lastCheck;
+  int fd, slot;
+
+  if (!gpioMmapReady() || (fdListen >= 0))
+    return -1;
+
+  arbiterAddress(&addr);
+
+  /* Only a stale socket is removed, never the one of a running daemon */
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  unlink(GPIO_ARBITER_PATH);
+
+  fdListen = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fdListen < 0)
+    return -1;
+  if ((bind(fdListen, (struct sockaddr *) &addr, sizeof(addr)) < 0) ||
+      (chown(GPIO_ARBITER_PATH, uid, gid) < 0) ||
+      (chmod(GPIO_ARBITER_PATH, (gid >= 0) ? 0660 : 0600) < 0) ||
+      (listen(fdListen, MAX_ARBITER_CLIENTS) < 0)) {
+    close(fdListen);
+    fdListen = -1;
+    return -1;
+  }
+  fcntl(fdListen, F_SETFL, O_NONBLOCK);
+
+  allowedUid = uid;
+  allowedGid = gid;
+  memset(owner, 0, sizeof(owner));
+  for (slot = 0; slot < MAX_ARBITER_CLIENTS; slot++)
+    clients[slot].fd = -1;
+
+  arbiterRunning = 1;
+  lastWork = lastCheck = gpioClockNs(CLOCK_MONOTONIC);
+
+  while (arbiterRunning) {
+    now = gpioClockNs(CLOCK_MONOTONIC);
+    if (serveRings()) {
+      lastWork = now;
+    } else if (now - lastWork >= ARBITER_SPIN_NS) {
+      /* Announce the sleep before the last look at the rings, so no posted command is missed */
+      setSleeping(1);
+      if (!serveRings())
+        serveSockets(ARBITER_REAP_MS);
+      setSleeping(0);
+      lastWork = lastCheck = gpioClockNs(CLOCK_MONOTONIC);
+      continue;
+    } else {
+      /* The BeagleBone has a single core, polling must leave it to the clients */
+      sched_yield();
+    }
+
+    if (now - lastCheck >= ARBITER_CHECK_NS) {
+      serveSockets(0);
+      lastCheck = now;
+    }
+  }
+
+  for (slot = 0; slot < MAX_ARBITER_CLIENTS; slot++)
+    if (clients[slot].fd >= 0)
+      dropClient(slot);
+
+  close(fdListen);
+  fdListen = -1;
+  unlink(GPIO_ARBITER_PATH);
+  return 0;
+}
+
+/**
+ * It makes gpioArbiterServe() return. It is safe to call from a signal handler, which
+ * also interrupts a sleeping daemon.
+ */
+
+void gpioArbiterShutdown(void)
+{
+  arbiterRunning = 0;
+}
+
+/**
+ * It connects this process as a client of the arbitration daemon.
+ * @return 0 on success and -1 if the daemon is not running, refused the process or has no free slot.
+ */
+
+int gpioArbiterConnect(void)
+{
+  struct sockaddr_un addr;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char control[CMSG_SPACE(sizeof(int))];
+  char status = 1;
+  void *map;
+  int fdRing = -1;
+
+  if (clientRing != NULL)
+    return 0;
+
+  arbiterAddress(&addr);
+  fdServer = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fdServer < 0)
+    return -1;
+  if (connect(fdServer, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    goto fail;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &status;
+  iov.iov_len = 1;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  if ((recvmsg(fdServer, &msg, 0) != 1) || (status != 0))
+    goto fail;
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if ((cmsg == NULL) || (cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS))
+    goto fail;
+  memcpy(&fdRing, CMSG_DATA(cmsg), sizeof(int));
+
+  map = mmap(NULL, sizeof(GPIOArbiterRing_t), PROT_READ | PROT_WRITE, MAP_SHARED, fdRing, 0);
+  close(fdRing);
+  if (map == MAP_FAILED)
+    goto fail;
+
+  clientRing = (GPIOArbiterRing_t *) map;
+  memset(owned, 0, sizeof(owned));
+  return 0;
+
+fail:
+  close(fdServer);
+  fdServer = -1;
+  return -1;
+}
+
+/**
+ * This function posts a command to the ring of this client and wakes the daemon if it sleeps.
+ * @param op a constant integer argument.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param value a constant integer argument.
+ * @return sequence number of the command on success and -1 if the ring is full.
+ */
+
+static int64_t postCommand(const int op, const unsigned int header, const unsigned int pin,
+  const int value)
+{
+  GPIOArbiterCmd_t *cmd;
+  uint32_t head = clientRing->head;
+  char wake = 0;
+
+  if (head - __atomic_load_n(&clientRing->tail, __ATOMIC_ACQUIRE) >= ARBITER_RING_SIZE)
+    return -1;
+
+  cmd = &clientRing->ring[head & (ARBITER_RING_SIZE - 1)];
+  cmd->op = op;
+  cmd->header = header;
+  cmd->pin = pin;
+  cmd->value = value;
+  __atomic_store_n(&clientRing->head, head + 1, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&clientRing->sleeping, __ATOMIC_SEQ_CST))
+    send(fdServer, &wake, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+  return head;
+}
+
+/**
+ * This function waits until the daemon completed a posted command.
+ * @param seq a constant int64_t argument, sequence number returned by postCommand().
+ * @return 0 on success and -1 on timeout.
+ */
+
+static int waitCommand(const int64_t seq)
+{
+  uint64_t deadline = gpioClockNs(CLOCK_MONOTONIC) + ARBITER_TIMEOUT_NS;
+  int loops = 0;
+
+  while ((int32_t) (__atomic_load_n(&clientRing->tail, __ATOMIC_ACQUIRE) - (uint32_t) seq) <= 0) {
+    if (++loops < ARBITER_SPIN_LOOPS)
+      continue;
+    if (gpioClockNs(CLOCK_MONOTONIC) > deadline)
+      return -1;
+    sched_yield();
+  }
+
+  return 0;
+}
+
+/**
+ * This function posts a command and returns its result.
+ * @param op a constant integer argument.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param value a constant integer argument.
+ * @return result of the command and -1 if it fails.
+ */
+
+static int runCommand(const int op, const unsigned int header, const unsigned int pin,
+  const int value)
+{
+  int64_t seq;
+
+  if (clientRing == NULL)
+    return -1;
+
+  seq = postCommand(op, header, pin, value);
+  if ((seq < 0) || waitCommand(seq))
+    return -1;
+
+  return clientRing->ring[seq & (ARBITER_RING_SIZE - 1)].result;
+}
+
+/**
+ * It takes GPIO header and pin and takes ownership of the pin for this process.
+ * Only the owner of a pin can change, write or read it through the daemon.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return 0 on success and -1 if the pin is owned by another process or it fails.
+ */
+
+int gpioArbiterClaim(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO = getGPIOPin(header, pin);
+
+  if ((pinGPIO == NULL) || runCommand(ARBITER_CMD_CLAIM, header, pin, 0))
+    return -1;
+
+  owned[pinGPIO->id / 32] |= 1u << (pinGPIO->id % 32);
+  return 0;
+}
+
+/**
+ * It takes GPIO header and pin and gives up ownership of the pin.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioArbiterRelease(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO = getGPIOPin(header, pin);
+
+  if ((pinGPIO == NULL) || runCommand(ARBITER_CMD_RELEASE, header, pin, 0))
+    return -1;
+
+  owned[pinGPIO->id / 32] &= ~(1u << (pinGPIO->id % 32));
+  return 0;
+}
+
+/**
+ * It takes GPIO header, pin and direction and sets the direction of an owned pin.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param direction a constant integer argument, GPIO_DIRECTION_INPUT or GPIO_DIRECTION_OUTPUT.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioArbiterSetDirection(const unsigned int header, const unsigned int pin, const int direction)
+{
+  return runCommand(ARBITER_CMD_DIRECTION, header, pin, direction);
+}
+
+/**
+ * It takes GPIO header, pin and value and queues a write of an owned pin. It returns without
+ * waiting for the daemon and without a system call unless the daemon has to be woken up.
+ * Writes of one process are applied in order. The daemon checks the ownership again.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param value a constant unsigned int argument.
+ * @see gpioArbiterFlush()
+ * @return 0 on success and -1 if the pin is not owned by this process or the ring is full.
+ */
+
+int gpioArbiterWrite(const unsigned int header, const unsigned int pin, const unsigned int value)
+{
+  const GPIOBit_t *pinGPIO;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if ((clientRing == NULL) || (pinGPIO == NULL) ||
+      !(owned[pinGPIO->id / 32] & (1u << (pinGPIO->id % 32))))
+    return -1;
+
+  return (postCommand(ARBITER_CMD_WRITE, header, pin, value != 0) < 0) ? -1 : 0;
+}
+
+/**
+ * It takes GPIO header and pin and reads an owned pin, after all writes queued before.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return value of the pin and -1 if it fails.
+ */
+
+int gpioArbiterRead(const unsigned int header, const unsigned int pin)
+{
+  return runCommand(ARBITER_CMD_READ, header, pin, 0);
+}
+
+/**
+ * It waits until the daemon applied all writes queued by this process.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioArbiterFlush(void)
+{
+  if (clientRing == NULL)
+    return -1;
+
+  return waitCommand((int64_t) clientRing->head - 1);
+}
+
+/**
+ * For disconnecting this process from the daemon. The daemon releases all pins it owns
+ * when the socket closes.
+ */
+
+void gpioArbiterDisconnect(void)
+{
+  if (clientRing == NULL)
+    return;
+
+  gpioArbiterFlush();
+
+  munmap(clientRing, sizeof(GPIOArbiterRing_t));
+  clientRing = NULL;
+  close(fdServer);
+  fdServer = -1;
+}
@@ -0,0 +1,54 @@
+/**********************************************************
+  GPIO arbitration daemon, owns the mmap() GPIO access
+    and serves the processes using gpioArbiter functions
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_arbiterd.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief GPIO arbitration daemon, owns the mmap() GPIO access and serves the processes using gpioArbiter functions
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include "bbbandroidHAL.h"
+
+/**
+ * This function stops the daemon on SIGINT and SIGTERM.
+ * @param sig an integer argument, unused.
+ */
+
+static void stopHandler(int sig)
+{
+  gpioArbiterShutdown();
+}
+
+/**
+ * The daemon takes an optional user id and an optional group id allowed to connect besides root,
+ * -1 for none. Only root may connect if none are given.
+ */
+
+int main(int argc, char *argv[])
+{
+  int ret;
+
+  if (openGPIO(GPIO_ACCESS_MMAP)) {
+    printf("gpio_arbiterd: memory map access to GPIO failed\n");
+    return 1;
+  }
+
+  signal(SIGINT, stopHandler);
+  signal(SIGTERM, stopHandler);
+
+  ret = gpioArbiterServe((argc > 1) ? atoi(argv[1]) : -1, (argc > 2) ? atoi(argv[2]) : -1);
+  if (ret)
+    printf("gpio_arbiterd: cannot listen on %s, another daemon may be running\n", GPIO_ARBITER_PATH);
+
+  closeGPIO();
+  return ret ? 1 : 0;
+}
@@ -0,0 +1,388 @@
+/**********************************************************
+  GPIO logic analyzer capture code for mmap() access
+    of GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_capture.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief GPIO logic analyzer capture code for mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_CAPTURE_CHANNELS  32			/**< Maximum number of pins captured at once */
+#define CAPTURE_MAGIC         "BBBLA001"	/**< Magic of the binary capture format */
+#define CAPTURE_MAX_NS        10000000000ULL	/**< Longest capture, the sampling thread holds the CPU until it ends */
+#define CAPTURE_CHECK_MASK    0xFFFF		/**< The run time is checked every CAPTURE_CHECK_MASK + 1 samples */
+
+/**
+ * typedef struct GPIOCaptureRecord_t for storing one change of the captured pins.
+ */
+
+typedef struct {
+  uint64_t sample;   /**< Index of the sample at which the pins changed */
+  uint32_t values;   /**< Bit i is the value of channel i from this sample on */
+} GPIOCaptureRecord_t;
+
+/**
+ * struct GPIOCapture for storing the state of a capture.
+ * Only samples that differ from the previous one are stored, so the ring holds
+ * the last maxRecords changes no matter how many samples were taken.
+ */
+
+struct GPIOCapture {
+  int count;                                          /**< Number of channels */
+  unsigned char header[MAX_CAPTURE_CHANNELS];         /**< Header of each channel */
+  unsigned char pin[MAX_CAPTURE_CHANNELS];            /**< Pin of each channel */
+  const GPIOBit_t *pins[MAX_CAPTURE_CHANNELS];        /**< Pin information of each channel */
+  uint32_t bankMask[GPIO_BANKS];                      /**< All channel masks in each bank */
+  GPIOCaptureRecord_t *records;                       /**< Preallocated ring of records */
+  uint32_t maxRecords;                                /**< Size of the ring */
+  uint64_t written;                                   /**< Number of records written, the ring keeps the last maxRecords */
+  uint64_t samples;                                   /**< Number of samples taken */
+  uint64_t maxSamples;                                /**< Samples to take */
+  uint64_t startTime;                                 /**< CLOCK_MONOTONIC time of the first sample in nano seconds */
+  uint64_t endTime;                                   /**< CLOCK_MONOTONIC time of the last sample in nano seconds */
+  int cpu;                                            /**< CPU the sampling thread is pinned to, -1 for any */
+  volatile int running;                               /**< Cleared to stop the sampling thread */
+  int started;                                        /**< Non zero while the sampling thread is not joined yet */
+  pthread_t thread;                                   /**< Sampling thread */
+};
+
+/**
+ * It takes arrays of GPIO headers and pins and the number of changes to keep, and
+ * creates a capture of those pins. The record ring is allocated, locked and touched here
+ * so that the sampling loop never page faults.
+ * @param headers a constant unsigned int array argument.
+ * @param pins a constant unsigned int array argument.
+ * @param count a constant integer argument, at most 32.
+ * @param maxRecords a constant uint32_t argument.
+ * @return pointer to the capture on success and NULL if it fails.
+ */
+
+GPIOCapture_t *gpioCaptureCreate(const unsigned int headers[], const unsigned int pins[],
+  const int count, const uint32_t maxRecords)
+{
+  GPIOCapture_t *cap;
+  const GPIOBit_t *pinGPIO;
+  int i;
+
+  if ((count <= 0) || (count > MAX_CAPTURE_CHANNELS) || (maxRecords == 0))
+    return NULL;
+
+  cap = (GPIOCapture_t *) calloc(1, sizeof(GPIOCapture_t));
+  if (cap == NULL)
+    return NULL;
+
+  for (i = 0; i < count; i++) {
+    pinGPIO = getGPIOPin(headers[i], pins[i]);
+    if (pinGPIO == NULL) {
+      free(cap);
+      return NULL;
+    }
+
+    cap->header[i] = headers[i];
+    cap->pin[i] = pins[i];
+    cap->pins[i] = pinGPIO;
+    cap->bankMask[pinGPIO->bank] |= pinGPIO->mask;
+  }
+  cap->count = count;
+
+  cap->records = (GPIOCaptureRecord_t *) malloc(sizeof(GPIOCaptureRecord_t) * maxRecords);
+  if (cap->records == NULL) {
+    free(cap);
+    return NULL;
+  }
+  memset(cap->records, 0, sizeof(GPIOCaptureRecord_t) * maxRecords);
+  mlock(cap->records, sizeof(GPIOCaptureRecord_t) * maxRecords);
+  cap->maxRecords = maxRecords;
+
+  return cap;
+}
+
+/**
+ * This function converts the masked DATA IN values of the banks to channel bits.
+ * @param cap a constant GPIOCapture_t pointer argument.
+ * @param reg a constant uint32_t array argument.
+ * @return bit i set if channel i is 1.
+ */
+
+static uint32_t captureChannels(const GPIOCapture_t *cap, const uint32_t reg[])
+{
+  uint32_t values = 0;
+  int i;
+
+  for (i = 0; i < cap->count; i++)
+    if (reg[cap->pins[i]->bank] & cap->pins[i]->mask)
+      values |= 1u << i;
+
+  return values;
+}
+
+/**
+ * This is the sampling thread. It reads the DATA IN register of every bank with captured
+ * pins in a tight loop and only stores a record when one of the captured pins changed.
+ * It never sleeps, so on a single core nothing else runs until it ends, which it does
+ * after maxSamples samples or CAPTURE_MAX_NS at the latest.
+ * @param arg a void pointer argument, the capture.
+ * @return NULL
+ */
+
+static void *captureThread(void *arg)
+{
+  GPIOCapture_t *cap = (GPIOCapture_t *) arg;
+  uint32_t reg[GPIO_BANKS] = { 0, 0, 0, 0 };
+  uint32_t last[GPIO_BANKS] = { 0, 0, 0, 0 };
+  GPIOCaptureRecord_t *rec;
+  uint64_t sample = 0, written = 0;
+  int i, changed;
+
+  gpioRealtimeThread(cap->cpu);
+
+  cap->startTime = gpioClockNs(CLOCK_MONOTONIC);
+
+  while (cap->running && (sample < cap->maxSamples)) {
+    if (((sample & CAPTURE_CHECK_MASK) == CAPTURE_CHECK_MASK) &&
+        (gpioClockNs(CLOCK_MONOTONIC) - cap->startTime >= CAPTURE_MAX_NS))
+      break;
+
+    changed = (sample == 0);
+    for (i = 0; i < GPIO_BANKS; i++) {
+      if (!cap->bankMask[i])
+        continue;
+      reg[i] = mapGPIO[i][GPIO_DATA_IN_REG/4] & cap->bankMask[i];
+      changed |= (reg[i] != last[i]);
+      last[i] = reg[i];
+    }
+
+    if (changed) {
+      rec = &cap->records[written % cap->maxRecords];
+      rec->sample = sample;
+      rec->values = captureChannels(cap, reg);
+      written++;
+    }
+    sample++;
+  }
+
+  cap->endTime = gpioClockNs(CLOCK_MONOTONIC);
+  cap->samples = sample;
+  cap->written = written;
+  cap->running = 0;
+
+  return NULL;
+}
+
+/**
+ * It starts sampling the pins of a capture on a new thread.
+ * GPIO has to be opened with memory map access. The thread samples without sleeping at
+ * real-time priority, so the capture is bounded: it ends after maxSamples samples or
+ * 10 seconds, whichever comes first.
+ * @param cap a GPIOCapture_t pointer argument.
+ * @param maxSamples a constant uint64_t argument, number of samples to take, not 0.
+ * @param cpu a constant integer argument, CPU to pin the sampling thread to or -1 for any.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioCaptureStart(GPIOCapture_t *cap, const uint64_t maxSamples, const int cpu)
+{
+  if ((cap == NULL) || cap->running || (maxSamples == 0) || !gpioMmapReady())
+    return -1;
+
+  /* A capture that ended by itself still has its thread to join */
+  if (cap->started) {
+    pthread_join(cap->thread, NULL);
+    cap->started = 0;
+  }
+
+  cap->maxSamples = maxSamples;
+  cap->cpu = cpu;
+  cap->samples = cap->written = 0;
+  cap->running = 1;
+
+  if (pthread_create(&cap->thread, NULL, captureThread, cap) != 0) {
+    cap->running = 0;
+    return -1;
+  }
+
+  cap->started = 1;
+  return 0;
+}
+
+/**
+ * It stops the sampling thread of a capture, or waits for it to take all of its samples
+ * if stop is 0, and returns once the capture results are ready to be exported.
+ * @param cap a GPIOCapture_t pointer argument.
+ * @param stop a constant integer argument.
+ * @return 0 on success and -1 if the capture was not started.
+ */
+
+int gpioCaptureStop(GPIOCapture_t *cap, const int stop)
+{
+  if ((cap == NULL) || !cap->started)
+    return -1;
+
+  if (stop)
+    cap->running = 0;
+
+  cap->started = 0;
+  return pthread_join(cap->thread, NULL) == 0 ? 0 : -1;
+}
+
+/**
+ * It returns the average sample rate of a finished capture.
+ * @param cap a constant GPIOCapture_t pointer argument.
+ * @return samples per second, 0 if nothing was captured.
+ */
+
+double gpioCaptureRate(const GPIOCapture_t *cap)
+{
+  if ((cap == NULL) || (cap->endTime <= cap->startTime))
+    return 0;
+
+  return (double) cap->samples * 1e9 / (double) (cap->endTime - cap->startTime);
+}
+
+/**
+ * This function returns the index in the ring of the oldest record still stored and the number of stored records.
+ * @param cap a constant GPIOCapture_t pointer argument.
+ * @param *count a uint32_t pointer argument that receives the number of stored records.
+ * @return index of the oldest stored record.
+ */
+
+static uint32_t captureOldest(const GPIOCapture_t *cap, uint32_t *count)
+{
+  if (cap->written <= cap->maxRecords) {
+    *count = cap->written;
+    return 0;
+  }
+
+  *count = cap->maxRecords;
+  return cap->written % cap->maxRecords;
+}
+
+/**
+ * It writes a finished capture to a Value Change Dump file.
+ * Sample indexes are converted to nano seconds with the average sample rate.
+ * @param cap a constant GPIOCapture_t pointer argument.
+ * @param path a constant char pointer argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioCaptureExportVCD(const GPIOCapture_t *cap, const char *path)
+{
+  const GPIOCaptureRecord_t *rec;
+  uint32_t first, count, prev = 0, n;
+  double period;
+  FILE *fd;
+  int i;
+
+  if (cap == NULL)
+    return -1;
+
+  fd = fopen(path, "w");
+  if (fd == NULL)
+    return -1;
+
+  period = cap->samples ? (double) (cap->endTime - cap->startTime) / cap->samples : 0;
+
+  fprintf(fd, "$comment bbbandroidHAL capture, %llu samples at %.0f Hz, start %llu ns $end\n",
+    (unsigned long long) cap->samples, gpioCaptureRate(cap), (unsigned long long) cap->startTime);
+  fprintf(fd, "$timescale 1 ns $end\n$scope module gpio $end\n");
+  for (i = 0; i < cap->count; i++)
+    fprintf(fd, "$var wire 1 %c P%d_%02d $end\n", '!' + i, cap->header[i], cap->pin[i]);
+  fprintf(fd, "$upscope $end\n$enddefinitions $end\n");
+
+  first = captureOldest(cap, &count);
+  for (n = 0; n < count; n++) {
+    rec = &cap->records[(first + n) % cap->maxRecords];
+
+    fprintf(fd, "#%llu\n", (unsigned long long) (rec->sample * period));
+    for (i = 0; i < cap->count; i++)
+      if ((n == 0) || ((rec->values ^ prev) & (1u << i)))
+        fprintf(fd, "%d%c\n", (rec->values >> i) & 1, '!' + i);
+    prev = rec->values;
+  }
+  fprintf(fd, "#%llu\n", (unsigned long long) (cap->endTime - cap->startTime));
+
+  fclose(fd);
+  return 0;
+}
+
+/**
+ * It writes a finished capture to a compact binary file. The file holds the magic "BBBLA001",
+ * the 32 bit channel count, 64 bit sample count, 32 bit record count, 64 bit start and end
+ * CLOCK_MONOTONIC times in nano seconds and the header/pin bytes of each channel, followed by
+ * the records of a 64 bit sample index and 32 bit values each.
+ * All values are stored in the native byte order.
+ * @param cap a constant GPIOCapture_t pointer argument.
+ * @param path a constant char pointer argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioCaptureExportBinary(const GPIOCapture_t *cap, const char *path)
+{
+  uint32_t first, count, n, channels;
+  FILE *fd;
+  int i;
+
+  if (cap == NULL)
+    return -1;
+
+  fd = fopen(path, "wb");
+  if (fd == NULL)
+    return -1;
+
+  first = captureOldest(cap, &count);
+  channels = cap->count;
+
+  fwrite(CAPTURE_MAGIC, 1, 8, fd);
+  fwrite(&channels, sizeof(channels), 1, fd);
+  fwrite(&cap->samples, sizeof(cap->samples), 1, fd);
+  fwrite(&count, sizeof(count), 1, fd);
+  fwrite(&cap->startTime, sizeof(cap->startTime), 1, fd);
+  fwrite(&cap->endTime, sizeof(cap->endTime), 1, fd);
+  for (i = 0; i < cap->count; i++) {
+    fputc(cap->header[i], fd);
+    fputc(cap->pin[i], fd);
+  }
+
+  for (n = 0; n < count; n++) {
+    fwrite(&cap->records[(first + n) % cap->maxRecords].sample, sizeof(uint64_t), 1, fd);
+    fwrite(&cap->records[(first + n) % cap->maxRecords].values, sizeof(uint32_t), 1, fd);
+  }
+
+  if (fclose(fd) != 0)
+    return -1;
+
+  return 0;
+}
+
+/**
+ * For freeing a capture created by gpioCaptureCreate(). A running capture is stopped first.
+ * @param cap a GPIOCapture_t pointer argument.
+ */
+
+void gpioCaptureFree(GPIOCapture_t *cap)
+{
+  if (cap == NULL)
+    return;
+
+  if (cap->started)
+    gpioCaptureStop(cap, 1);
+
+  munlock(cap->records, sizeof(GPIOCaptureRecord_t) * cap->maxRecords);
+  free(cap->records);
+  free(cap);
+}
@@ -0,0 +1,371 @@
+/**********************************************************
+  GPIO edge counting and frequency/duty measurement code
+    using edge events or mmap() polling
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_counter.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief GPIO edge counting and frequency/duty measurement code using edge events or mmap() polling
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_COUNTER_PINS 32	/**< Maximum number of pins counted at once */
+
+/**
+ * typedef struct GPIOCounterPin_t for storing the state of one counted pin.
+ * The published counts are protected by a sequence number so that readers never block the sampler.
+ */
+
+typedef struct {
+  const GPIOBit_t *pinGPIO;   /**< Pin information */
+  unsigned char header;       /**< Header of the pin */
+  unsigned char pin;          /**< Pin of the pin */
+  int fd;                     /**< Value file descriptor when counting with edge events */
+  int level;                  /**< Last level seen by the sampler */
+  uint64_t lastRise;          /**< Time of the last rising edge in nano seconds, 0 if none yet */
+  volatile uint32_t seq;      /**< Odd while the sampler updates count */
+  GPIOCount_t count;          /**< Published counts */
+} GPIOCounterPin_t;
+
+static GPIOCounterPin_t counters[MAX_COUNTER_PINS];	/**< Counted pins */
+static int counterPins = 0;	/**< Number of counted pins */
+static int counterCpu = -1;	/**< CPU the sampler thread is pinned to, -1 for any */
+static uint32_t counterPoll = 20000;	/**< Poll interval of the memory mapped sampler in nano seconds */
+static volatile int counterRunning = 0;	/**< Cleared to stop the sampler thread */
+static pthread_t counterThread;	/**< Sampler thread */
+
+/**
+ * It takes GPIO header and pin and adds the pin to the counting service.
+ * Pins have to be added before gpioCounterStart().
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioCounterAdd(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO;
+  GPIOCounterPin_t *c;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if ((pinGPIO == NULL) || counterRunning || (counterPins >= MAX_COUNTER_PINS))
+    return -1;
+
+  c = &counters[counterPins++];
+  memset(c, 0, sizeof(*c));
+  c->pinGPIO = pinGPIO;
+  c->header = header;
+  c->pin = pin;
+  c->fd = -1;
+
+  return 0;
+}
+
+/**
+ * This function records an edge of a counted pin and publishes the new counts.
+ * @param c a GPIOCounterPin_t pointer argument.
+ * @param level a constant integer argument, level after the edge.
+ * @param timestamp a constant uint64_t argument, time of the edge in nano seconds.
+ */
+
+static void counterEdge(GPIOCounterPin_t *c, const int level, const uint64_t timestamp)
+{
+  if (level == c->level)
+    return;
+  c->level = level;
+
+  __atomic_store_n(&c->seq, c->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  c->count.edges++;
+  if (level) {
+    c->count.rising++;
+    if (c->lastRise)
+      c->count.period_ns = timestamp - c->lastRise;
+    c->lastRise = timestamp;
+  } else if (c->lastRise) {
+    c->count.high_ns = timestamp - c->lastRise;
+  }
+  c->count.timestamp = timestamp;
+
+  __atomic_store_n(&c->seq, c->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * This function records a rising and a falling edge that both happened between two wake ups
+ * of the sampler, so only the level they returned to was seen. Their times are unknown, so
+ * the period and high time restart from the next rising edge.
+ * @param c a GPIOCounterPin_t pointer argument.
+ * @param timestamp a constant uint64_t argument, time the pair was noticed in nano seconds.
+ */
+
+static void counterPair(GPIOCounterPin_t *c, const uint64_t timestamp)
+{
+  __atomic_store_n(&c->seq, c->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  c->count.edges += 2;
+  c->count.rising++;
+  c->lastRise = 0;
+  c->count.timestamp = timestamp;
+
+  __atomic_store_n(&c->seq, c->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * This is the sampler thread when the pins have no edge events. It reads the DATA IN register
+ * of every bank with counted pins once per poll interval and only takes a timestamp when
+ * one of them changed. It sleeps between polls so it never starves the rest of a single
+ * core system at its real-time priority.
+ * @param arg a void pointer argument, unused.
+ * @return NULL
+ */
+
+static void *counterPollThread(void *arg)
+{
+  uint32_t bankMask[GPIO_BANKS] = { 0, 0, 0, 0 };
+  uint32_t last[GPIO_BANKS] = { 0, 0, 0, 0 };
+  uint32_t reg, changed;
+  struct timespec ts;
+  uint64_t now, next;
+  int i, n;
+
+  gpioRealtimeThread(counterCpu);
+  next = gpioClockNs(CLOCK_MONOTONIC);
+
+  for (n = 0; n < counterPins; n++)
+    bankMask[counters[n].pinGPIO->bank] |= counters[n].pinGPIO->mask;
+
+  for (i = 0; i < GPIO_BANKS; i++)
+    if (bankMask[i])
+      last[i] = mapGPIO[i][GPIO_DATA_IN_REG/4] & bankMask[i];
+
+  for (n = 0; n < counterPins; n++)
+    counters[n].level = (last[counters[n].pinGPIO->bank] & counters[n].pinGPIO->mask) != 0;
+
+  while (counterRunning) {
+    next += counterPoll;
+    ts.tv_sec = next / 1000000000ULL;
+    ts.tv_nsec = next % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+    for (i = 0; i < GPIO_BANKS; i++) {
+      if (!bankMask[i])
+        continue;
+
+      reg = mapGPIO[i][GPIO_DATA_IN_REG/4] & bankMask[i];
+      changed = reg ^ last[i];
+      if (!changed)
+        continue;
+      last[i] = reg;
+
+      now = gpioClockNs(CLOCK_MONOTONIC);
+      for (n = 0; n < counterPins; n++)
+        if ((counters[n].pinGPIO->bank == i) && (changed & counters[n].pinGPIO->mask))
+          counterEdge(&counters[n], (reg & counters[n].pinGPIO->mask) != 0, now);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * This is the sampler thread when the pins have edge events. It waits for edge events
+ * on the value files of the counted pins. An event that reads the level seen last means
+ * a rising and falling edge pair was missed in between, and is counted as such.
+ * @param arg a void pointer argument, the epoll file descriptor.
+ * @return NULL
+ */
+
+static void *counterEventThread(void *arg)
+{
+  int fdEpoll = (int) (intptr_t) arg;
+  struct epoll_event ev[MAX_COUNTER_PINS];
+  GPIOCounterPin_t *c;
+  uint64_t now;
+  int i, n, level;
+
+  gpioRealtimeThread(counterCpu);
+
+  while (counterRunning) {
+    n = epoll_wait(fdEpoll, ev, MAX_COUNTER_PINS, 100);
+    if (n <= 0)
+      continue;
+
+    now = gpioClockNs(CLOCK_MONOTONIC);
+    for (i = 0; i < n; i++) {
+      c = &counters[ev[i].data.u32];
+      level = gpioEventLevel(c->fd);
+      if (level < 0)
+        continue;
+      if (level == c->level)
+        counterPair(c, now);
+      else
+        counterEdge(c, level, now);
+    }
+  }
+
+  close(fdEpoll);
+  return NULL;
+}
+
+/**
+ * This function closes the value files of the counted pins and the epoll file descriptor.
+ * @param fdEpoll a constant integer argument, -1 if there is none.
+ */
+
+static void counterCloseFiles(const int fdEpoll)
+{
+  int n;
+
+  if (fdEpoll >= 0)
+    close(fdEpoll);
+  for (n = 0; n < counterPins; n++) {
+    if (counters[n].fd >= 0)
+      close(counters[n].fd);
+    counters[n].fd = -1;
+  }
+}
+
+/**
+ * It starts counting edges on the added pins. Both edges are enabled through the file system
+ * and the thread waits for edge events, so no pulse is missed. If a pin has no edge events,
+ * for example because it is not exported, and GPIO is memory mapped, the pins are polled by
+ * a pinned thread instead.
+ * @param cpu a constant integer argument, CPU to pin the sampler thread to or -1 for any.
+ * @param poll_us a constant uint32_t argument, poll interval when polling in micro seconds,
+ * pulses shorter than it can be missed.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioCounterStart(const int cpu, const uint32_t poll_us)
+{
+  GPIOCounterPin_t *c;
+  int fdEpoll, n, ret;
+
+  if (counterRunning || (counterPins == 0) || (poll_us == 0) || (poll_us > 1000000))
+    return -1;
+
+  counterCpu = cpu;
+  counterPoll = poll_us * 1000;
+
+  fdEpoll = epoll_create(MAX_COUNTER_PINS);
+  for (n = 0; (fdEpoll >= 0) && (n < counterPins); n++) {
+    c = &counters[n];
+    if (gpioSetEdge(c->header, c->pin, GPIO_EDGE_BOTH))
+      break;
+    c->fd = gpioEventWatch(fdEpoll, c->pinGPIO, n, &c->level);
+    if (c->fd < 0)
+      break;
+  }
+
+  counterRunning = 1;
+  if ((fdEpoll >= 0) && (n == counterPins)) {
+    ret = pthread_create(&counterThread, NULL, counterEventThread, (void *) (intptr_t) fdEpoll);
+  } else {
+    counterCloseFiles(fdEpoll);
+    fdEpoll = -1;
+    ret = gpioMmapReady() ? pthread_create(&counterThread, NULL, counterPollThread, NULL) : -1;
+  }
+
+  if (ret != 0) {
+    counterRunning = 0;
+    counterCloseFiles(fdEpoll);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * It takes GPIO header and pin and copies a consistent snapshot of the counts of the pin.
+ * This never blocks the sampler thread.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param *count a GPIOCount_t pointer argument.
+ * @return 0 on success and -1 if the pin is not counted.
+ */
+
+int gpioCounterRead(const unsigned int header, const unsigned int pin, GPIOCount_t *count)
+{
+  GPIOCounterPin_t *c = NULL;
+  uint32_t seq;
+  int n;
+
+  for (n = 0; n < counterPins; n++)
+    if ((counters[n].header == header) && (counters[n].pin == pin))
+      c = &counters[n];
+  if (c == NULL)
+    return -1;
+
+  do {
+    seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+    *count = c->count;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) || (seq != __atomic_load_n(&c->seq, __ATOMIC_RELAXED)));
+
+  return 0;
+}
+
+/**
+ * It takes GPIO header and pin and returns the frequency of the pin from its last full period.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return frequency in Hz, 0 if no full period was seen yet and -1 if the pin is not counted.
+ */
+
+double gpioCounterFrequency(const unsigned int header, const unsigned int pin)
+{
+  GPIOCount_t count;
+
+  if (gpioCounterRead(header, pin, &count))
+    return -1;
+
+  return count.period_ns ? 1e9 / count.period_ns : 0;
+}
+
+/**
+ * It takes GPIO header and pin and returns the duty cycle of the pin from its last full period.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return duty cycle from 0 to 1 and -1 if the pin is not counted.
+ */
+
+double gpioCounterDuty(const unsigned int header, const unsigned int pin)
+{
+  GPIOCount_t count;
+
+  if (gpioCounterRead(header, pin, &count))
+    return -1;
+
+  return count.period_ns ? (double) count.high_ns / count.period_ns : 0;
+}
+
+/**
+ * For stopping the sampler thread and removing all counted pins.
+ */
+
+void gpioCounterStop(void)
+{
+  if (counterRunning) {
+    counterRunning = 0;
+    pthread_join(counterThread, NULL);
+  }
+
+  counterCloseFiles(-1);
+  counterPins = 0;
+}
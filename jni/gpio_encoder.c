@@ -0,0 +1,253 @@
+/**********************************************************
+  Quadrature encoder decoding code for mmap() access
+    of GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_encoder.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Quadrature encoder decoding code for mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_ENCODERS          16	/**< Maximum number of encoders decoded at once */
+
+/**
+ * Position change for each (previous state << 2 | current state) of the A/B phases.
+ * Transitions where both phases changed at once are invalid and count as 0.
+ */
+
+static const int8_t quadratureTable[16] = {
+   0, -1,  1,  0,
+   1,  0,  0, -1,
+  -1,  0,  0,  1,
+   0,  1, -1,  0
+};
+
+/**
+ * typedef struct GPIOEncoder_t for storing the state of one encoder.
+ */
+
+typedef struct {
+  const GPIOBit_t *pinA;     /**< Pin information of phase A */
+  const GPIOBit_t *pinB;     /**< Pin information of phase B */
+  unsigned int state;        /**< Last A/B state, A is bit 1 and B is bit 0 */
+  int64_t position;          /**< Position in counts, read atomically */
+  int64_t velocity;          /**< Velocity in milli counts per second, read atomically */
+  int64_t windowPosition;    /**< Position at the start of the velocity window */
+  uint32_t errors;           /**< Number of invalid transitions seen */
+} GPIOEncoder_t;
+
+static GPIOEncoder_t encoders[MAX_ENCODERS];	/**< Decoded encoders */
+static int encoderCount = 0;	/**< Number of decoded encoders */
+static int encoderCpu = -1;		/**< CPU the sampler thread is pinned to, -1 for any */
+static uint64_t encoderWindow = 10000000;	/**< Velocity window in nano seconds */
+static uint32_t encoderSample = 20000;	/**< Sample interval in nano seconds */
+static volatile int encoderRunning = 0;	/**< Cleared to stop the sampler thread */
+static pthread_t encoderThread;	/**< Sampler thread */
+
+/**
+ * It takes the GPIO header and pin of the A and B phases of an encoder and adds it to the decoder.
+ * Encoders have to be added before gpioEncoderStart(). When both phases are in the same bank
+ * they are sampled with a single DATA IN read.
+ * @param headerA a constant unsigned int argument.
+ * @param pinA a constant unsigned int argument.
+ * @param headerB a constant unsigned int argument.
+ * @param pinB a constant unsigned int argument.
+ * @return index of the encoder on success and -1 if it fails.
+ */
+
+int gpioEncoderAdd(const unsigned int headerA, const unsigned int pinA,
+  const unsigned int headerB, const unsigned int pinB)
+{
+  GPIOEncoder_t *enc;
+
+  if (encoderRunning || (encoderCount >= MAX_ENCODERS))
+    return -1;
+
+  enc = &encoders[encoderCount];
+  memset(enc, 0, sizeof(*enc));
+  enc->pinA = getGPIOPin(headerA, pinA);
+  enc->pinB = getGPIOPin(headerB, pinB);
+  if ((enc->pinA == NULL) || (enc->pinB == NULL))
+    return -1;
+
+  return encoderCount++;
+}
+
+/**
+ * This is the sampler thread. Every sample reads the DATA IN register of each bank
+ * with encoder phases once and decodes all encoders from those values. It sleeps until
+ * the next sample so it never starves the rest of a single core system at its real-time priority.
+ * @param arg a void pointer argument, unused.
+ * @return NULL
+ */
+
+static void *encoderSampleThread(void *arg)
+{
+  uint32_t bankMask[GPIO_BANKS] = { 0, 0, 0, 0 };
+  uint32_t reg[GPIO_BANKS] = { 0, 0, 0, 0 };
+  uint64_t windowStart, now;
+  struct timespec ts;
+  GPIOEncoder_t *enc;
+  unsigned int state;
+  int8_t delta;
+  int i, n;
+
+  gpioRealtimeThread(encoderCpu);
+
+  for (n = 0; n < encoderCount; n++) {
+    bankMask[encoders[n].pinA->bank] |= encoders[n].pinA->mask;
+    bankMask[encoders[n].pinB->bank] |= encoders[n].pinB->mask;
+  }
+
+  for (i = 0; i < GPIO_BANKS; i++)
+    if (bankMask[i])
+      reg[i] = mapGPIO[i][GPIO_DATA_IN_REG/4];
+
+  for (n = 0; n < encoderCount; n++) {
+    enc = &encoders[n];
+    enc->state = ((reg[enc->pinA->bank] & enc->pinA->mask) ? 2 : 0) |
+      ((reg[enc->pinB->bank] & enc->pinB->mask) ? 1 : 0);
+    enc->windowPosition = enc->position;
+  }
+  windowStart = now = gpioClockNs(CLOCK_MONOTONIC);
+
+  while (encoderRunning) {
+    now += encoderSample;
+    ts.tv_sec = now / 1000000000ULL;
+    ts.tv_nsec = now % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+    for (i = 0; i < GPIO_BANKS; i++)
+      if (bankMask[i])
+        reg[i] = mapGPIO[i][GPIO_DATA_IN_REG/4];
+
+    for (n = 0; n < encoderCount; n++) {
+      enc = &encoders[n];
+      state = ((reg[enc->pinA->bank] & enc->pinA->mask) ? 2 : 0) |
+        ((reg[enc->pinB->bank] & enc->pinB->mask) ? 1 : 0);
+      if (state == enc->state)
+        continue;
+
+      delta = quadratureTable[(enc->state << 2) | state];
+      if (delta)
+        __atomic_store_n(&enc->position, enc->position + delta, __ATOMIC_RELAXED);
+      else
+        enc->errors++;
+      enc->state = state;
+    }
+
+    /* The deadline just slept to stands in for the time of the sample */
+    if (now - windowStart < encoderWindow)
+      continue;
+
+    for (n = 0; n < encoderCount; n++) {
+      enc = &encoders[n];
+      __atomic_store_n(&enc->velocity,
+        (enc->position - enc->windowPosition) * 1000000000000LL / (int64_t) (now - windowStart),
+        __ATOMIC_RELAXED);
+      enc->windowPosition = enc->position;
+    }
+    windowStart = now;
+  }
+
+  return NULL;
+}
+
+/**
+ * It starts decoding the added encoders on a sampler thread. GPIO has to be opened with memory map access.
+ * @param cpu a constant integer argument, CPU to pin the sampler thread to or -1 for any.
+ * @param sample_us a constant uint32_t argument, sample interval in micro seconds, shorter than the
+ * fastest A/B transition expected.
+ * @param window_us a constant uint32_t argument, time over which the velocity is averaged in micro seconds.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioEncoderStart(const int cpu, const uint32_t sample_us, const uint32_t window_us)
+{
+  if (encoderRunning || (encoderCount == 0) || (sample_us == 0) || (sample_us > 1000000) ||
+      (window_us == 0) || !gpioMmapReady())
+    return -1;
+
+  encoderCpu = cpu;
+  encoderSample = sample_us * 1000;
+  encoderWindow = (uint64_t) window_us * 1000;
+  encoderRunning = 1;
+
+  if (pthread_create(&encoderThread, NULL, encoderSampleThread, NULL) != 0) {
+    encoderRunning = 0;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * It takes an encoder index and returns the position of the encoder without blocking the sampler.
+ * @param index a constant integer argument.
+ * @return position in counts, 0 for an invalid index.
+ */
+
+int64_t gpioEncoderPosition(const int index)
+{
+  if ((index < 0) || (index >= encoderCount))
+    return 0;
+
+  return __atomic_load_n(&encoders[index].position, __ATOMIC_RELAXED);
+}
+
+/**
+ * It takes an encoder index and returns the velocity of the encoder over the last window
+ * without blocking the sampler.
+ * @param index a constant integer argument.
+ * @return velocity in counts per second, 0 for an invalid index.
+ */
+
+double gpioEncoderVelocity(const int index)
+{
+  if ((index < 0) || (index >= encoderCount))
+    return 0;
+
+  return __atomic_load_n(&encoders[index].velocity, __ATOMIC_RELAXED) / 1000.0;
+}
+
+/**
+ * It takes an encoder index and returns the number of invalid transitions, where both
+ * phases changed between two samples, which means the sampler is too slow for the encoder.
+ * @param index a constant integer argument.
+ * @return number of invalid transitions, 0 for an invalid index.
+ */
+
+uint32_t gpioEncoderErrors(const int index)
+{
+  if ((index < 0) || (index >= encoderCount))
+    return 0;
+
+  return encoders[index].errors;
+}
+
+/**
+ * For stopping the sampler thread and removing all encoders.
+ */
+
+void gpioEncoderStop(void)
+{
+  if (encoderRunning) {
+    encoderRunning = 0;
+    pthread_join(encoderThread, NULL);
+  }
+
+  encoderCount = 0;
+}
@@ -0,0 +1,520 @@
+/**********************************************************
+  GPIO edge event interface code using the file system
+    edge attribute and epoll()
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_event.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief GPIO edge event interface code using the file system edge attribute and epoll()
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define GPIO_EVENT_QUEUE_SIZE 256	/**< Number of events held in the event queue, must be a power of two */
+#define MAX_EVENT_PINS        32	/**< Maximum number of pins watched for events at once */
+#ifndef GPIO_EVENT_EPOLL
+#define GPIO_EVENT_EPOLL      (EPOLLPRI | EPOLLERR)	/**< epoll events of a changed value file, the host tests watch FIFOs for EPOLLIN */
+#endif
+
+/**
+ * typedef struct GPIOWatch_t for storing a pin that is watched for edge events.
+ */
+
+typedef struct {
+  int fd;                /**< File descriptor of the value file, -1 if the slot is free */
+  unsigned char header;  /**< Header of the watched pin */
+  unsigned char pin;     /**< Pin of the watched pin */
+  int level;             /**< Last level reported */
+  int candidate;         /**< Level waiting to be held for the glitch time, -1 if none */
+  uint64_t candidateTime;  /**< Time of the edge to the candidate level */
+  uint64_t lockout;      /**< Edges are ignored until this time after a reported edge */
+  uint64_t due;          /**< Time to sample the pin again, 0 if nothing is pending */
+  uint32_t stable;       /**< Debounce time after a reported edge in nano seconds, 0 for none */
+  uint32_t glitch;       /**< Minimum width of a pulse in nano seconds, 0 for none */
+  uint32_t suppressed;   /**< Number of edges filtered out */
+} GPIOWatch_t;
+
+static const char *edgeNames[] = { "none", "rising", "falling", "both" };	/**< Values of the edge attribute */
+
+static char fsBuf[64];	/**< Buffer to store generated file system path using snprintf */
+static int fdEpoll = -1;	/**< epoll file descriptor, -1 until the first pin is added */
+static GPIOWatch_t watches[MAX_EVENT_PINS];	/**< Watched pins */
+
+static GPIOEvent_t queue[GPIO_EVENT_QUEUE_SIZE];	/**< Event queue */
+static unsigned int queueHead = 0;	/**< Index of the next event to be written by gpioEventWait() */
+static unsigned int queueTail = 0;	/**< Index of the next event to be drained by gpioEventRead() */
+static unsigned int queueDropped = 0;	/**< Number of events dropped because the queue was full */
+
+/**
+ * It reads the level of a watched pin from its value file. sysfs value files are
+ * read from offset 0, which also rearms the POLLPRI notification; value files that cannot
+ * seek, like the FIFOs of the host tests, deliver one level per read instead.
+ * @param fd a constant integer argument.
+ * @return 1 or 0 for the level and -1 if it fails.
+ */
+
+int gpioEventLevel(const int fd)
+{
+  int len;
+  char ch;
+
+  len = pread(fd, &ch, 1, 0);
+  if ((len < 0) && (errno == ESPIPE))
+    len = read(fd, &ch, 1);
+  if (len < 1)
+    return -1;
+
+  return ch != '0';
+}
+
+/**
+ * It takes GPIO header, pin and edge and writes the edge to the edge attribute of the pin.
+ * The pin has to be exported and configured as an input.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param edge a constant integer argument, one of GPIO_EDGE_NONE, GPIO_EDGE_RISING, GPIO_EDGE_FALLING and GPIO_EDGE_BOTH.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioSetEdge(const unsigned int header, const unsigned int pin, const int edge)
+{
+  const GPIOBit_t *pinGPIO;
+  FILE *fd;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if ((pinGPIO == NULL) || (edge < GPIO_EDGE_NONE) || (edge > GPIO_EDGE_BOTH))
+    return -1;
+
+  snprintf(fsBuf, sizeof(fsBuf), SYSFS_GPIO_DIR "/gpio%d/edge", pinGPIO->id);
+
+  fd = fopen(fsBuf, "w");
+  if (fd == NULL)
+    return -1;
+
+  fprintf(fd, "%s", edgeNames[edge]);
+  fclose(fd);
+
+  return 0;
+}
+
+/**
+ * It opens the value file of a pin, consumes its current level and registers the file with an
+ * epoll file descriptor for the events of a changed value file. gpio_counter.c watches its pins
+ * with it too.
+ * @param epfd a constant integer argument, epoll file descriptor.
+ * @param pinGPIO a constant GPIOBit_t pointer argument.
+ * @param data a constant uint32_t argument, returned in the data.u32 of the epoll events.
+ * @param level an integer pointer argument that receives the current level.
+ * @return file descriptor of the value file on success and -1 if it fails.
+ */
+
+int gpioEventWatch(const int epfd, const GPIOBit_t *pinGPIO, const uint32_t data, int *level)
+{
+  struct epoll_event ev;
+  char path[64];
+  int fd;
+
+  snprintf(path, sizeof(path), SYSFS_GPIO_DIR "/gpio%d/value", pinGPIO->id);
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  /* Consume the current state so only later edges are reported */
+  *level = gpioEventLevel(fd) == 1;
+
+  /* sysfs signals a changed value file with POLLPRI */
+  ev.events = GPIO_EVENT_EPOLL;
+  ev.data.u32 = data;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/**
+ * It takes GPIO header and pin and starts watching the pin for edge events.
+ * The value file is opened once here and stays registered with epoll until gpioEventRemove().
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @see gpioSetEdge()
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioEventAdd(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO;
+  int i, slot = -1;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if (pinGPIO == NULL)
+    return -1;
+
+  if (fdEpoll < 0) {
+    fdEpoll = epoll_create(MAX_EVENT_PINS);
+    if (fdEpoll < 0)
+      return -1;
+
+    for (i = 0; i < MAX_EVENT_PINS; i++)
+      watches[i].fd = -1;
+  }
+
+  for (i = 0; i < MAX_EVENT_PINS; i++) {
+    if (watches[i].fd < 0) {
+      if (slot < 0)
+        slot = i;
+    } else if ((watches[i].header == header) && (watches[i].pin == pin)) {
+      return 0; /* Already watched */
+    }
+  }
+  if (slot < 0)
+    return -1;
+
+  watches[slot].fd = gpioEventWatch(fdEpoll, pinGPIO, slot, &watches[slot].level);
+  if (watches[slot].fd < 0)
+    return -1;
+  watches[slot].header = header;
+  watches[slot].pin = pin;
+  watches[slot].candidate = -1;
+  watches[slot].lockout = watches[slot].due = 0;
+  watches[slot].stable = watches[slot].glitch = 0;
+  watches[slot].suppressed = 0;
+
+  return 0;
+}
+
+/**
+ * It takes GPIO header and pin and stops watching the pin for edge events.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return 0 on success and -1 if the pin was not watched.
+ */
+
+int gpioEventRemove(const unsigned int header, const unsigned int pin)
+{
+  int i;
+
+  if (fdEpoll < 0)
+    return -1;
+
+  for (i = 0; i < MAX_EVENT_PINS; i++) {
+    if ((watches[i].fd >= 0) && (watches[i].header == header) && (watches[i].pin == pin)) {
+      epoll_ctl(fdEpoll, EPOLL_CTL_DEL, watches[i].fd, NULL);
+      close(watches[i].fd);
+      watches[i].fd = -1;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * This function appends an event to the event queue.
+ * It is only called from the thread running gpioEventWait() so the queue has a single producer.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param value a constant integer argument.
+ * @param timestamp a constant uint64_t argument, CLOCK_MONOTONIC time in nano seconds.
+ */
+
+static void gpioEventPush(const unsigned int header, const unsigned int pin,
+  const int value, const uint64_t timestamp)
+{
+  unsigned int head = queueHead;
+
+  if (head - __atomic_load_n(&queueTail, __ATOMIC_ACQUIRE) >= GPIO_EVENT_QUEUE_SIZE) {
+    queueDropped++;
+    return;
+  }
+
+  queue[head & (GPIO_EVENT_QUEUE_SIZE - 1)].header = header;
+  queue[head & (GPIO_EVENT_QUEUE_SIZE - 1)].pin = pin;
+  queue[head & (GPIO_EVENT_QUEUE_SIZE - 1)].value = value;
+  queue[head & (GPIO_EVENT_QUEUE_SIZE - 1)].timestamp = timestamp;
+
+  __atomic_store_n(&queueHead, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * It takes GPIO header and pin of a watched pin and sets its edge filter. Edges filtered out
+ * never reach the event queue.
+ * The glitch filter only reports a new level once the pin held it for the glitch time, so
+ * pulses shorter than that are dropped, at the cost of reporting edges that much later.
+ * The debounce ignores all edges for the stable time after a reported edge and then reports
+ * the level the pin settled at if it differs.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param stable_us a constant uint32_t argument, debounce time in micro seconds, 0 for none.
+ * @param glitch_us a constant uint32_t argument, minimum pulse width in micro seconds, 0 for none.
+ * @see gpioEventSuppressed()
+ * @return 0 on success and -1 if the pin is not watched.
+ */
+
+int gpioEventFilter(const unsigned int header, const unsigned int pin,
+  const uint32_t stable_us, const uint32_t glitch_us)
+{
+  int i;
+
+  for (i = 0; i < MAX_EVENT_PINS; i++) {
+    if ((fdEpoll >= 0) && (watches[i].fd >= 0) &&
+        (watches[i].header == header) && (watches[i].pin == pin)) {
+      watches[i].stable = stable_us * 1000;
+      watches[i].glitch = glitch_us * 1000;
+      watches[i].candidate = -1;
+      watches[i].lockout = watches[i].due = 0;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * It takes GPIO header and pin of a watched pin and returns the number of its edges
+ * that were filtered out, for tuning the filter times.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @see gpioEventFilter()
+ * @return number of filtered edges, 0 if the pin is not watched.
+ */
+
+uint32_t gpioEventSuppressed(const unsigned int header, const unsigned int pin)
+{
+  int i;
+
+  for (i = 0; i < MAX_EVENT_PINS; i++)
+    if ((fdEpoll >= 0) && (watches[i].fd >= 0) &&
+        (watches[i].header == header) && (watches[i].pin == pin))
+      return watches[i].suppressed;
+
+  return 0;
+}
+
+/**
+ * This function reports a new level of a watched pin and starts its debounce time.
+ * @param watch a GPIOWatch_t pointer argument.
+ * @param value a constant integer argument.
+ * @param timestamp a constant uint64_t argument, time of the edge.
+ * @return 1, the number of events queued.
+ */
+
+static int gpioEventAccept(GPIOWatch_t *watch, const int value, const uint64_t timestamp)
+{
+  gpioEventPush(watch->header, watch->pin, value, timestamp);
+  watch->level = value;
+  watch->candidate = -1;
+  watch->lockout = watch->stable ? timestamp + watch->stable : 0;
+  watch->due = watch->lockout;
+
+  return 1;
+}
+
+/**
+ * This function passes a level read after an edge of a watched pin through its filter.
+ * @param watch a GPIOWatch_t pointer argument.
+ * @param value a constant integer argument, level read from the value file.
+ * @param now a constant uint64_t argument, CLOCK_MONOTONIC time in nano seconds.
+ * @return number of events queued.
+ */
+
+static int gpioEventFilterEdge(GPIOWatch_t *watch, const int value, const uint64_t now)
+{
+  if (!watch->stable && !watch->glitch) {
+    gpioEventPush(watch->header, watch->pin, value, now);
+    watch->level = value;
+    return 1;
+  }
+
+  if (now < watch->lockout) {
+    /* Bouncing, the settled level is sampled when the debounce time ends */
+    watch->suppressed++;
+    return 0;
+  }
+
+  if (value == watch->level) {
+    /* A pulse shorter than the glitch time, or two edges seen as one */
+    watch->suppressed += (watch->candidate >= 0) ? 2 : 1;
+    watch->candidate = -1;
+    watch->due = 0;
+    return 0;
+  }
+
+  if (!watch->glitch)
+    return gpioEventAccept(watch, value, now);
+
+  if (watch->candidate < 0) {
+    watch->candidate = value;
+    watch->candidateTime = now;
+    watch->due = now + watch->glitch;
+  }
+
+  return 0;
+}
+
+/**
+ * This function samples the watched pins whose glitch or debounce time ended.
+ * @param now a constant uint64_t argument, CLOCK_MONOTONIC time in nano seconds.
+ * @return number of events queued.
+ */
+
+static int gpioEventFilterDue(const uint64_t now)
+{
+  GPIOWatch_t *watch;
+  int i, value, count = 0;
+
+  for (i = 0; i < MAX_EVENT_PINS; i++) {
+    watch = &watches[i];
+    if ((watch->fd < 0) || !watch->due || (watch->due > now))
+      continue;
+
+    watch->due = 0;
+    value = gpioEventLevel(watch->fd);
+    if (value < 0)
+      continue;
+
+    if (watch->candidate >= 0) {
+      if (value == watch->candidate)
+        count += gpioEventAccept(watch, value, watch->candidateTime);
+      else
+        watch->suppressed++;
+      watch->candidate = -1;
+    } else {
+      watch->lockout = 0;
+      if (value != watch->level)
+        count += gpioEventFilterEdge(watch, value, now);
+    }
+  }
+
+  return count;
+}
+
+/**
+ * It waits for edge events on the watched pins, passes them through the edge filter of
+ * each pin and appends the ones that pass to the event queue with their CLOCK_MONOTONIC
+ * timestamp. Events are then drained with gpioEventRead().
+ * @param timeout_ms a constant integer argument, -1 waits forever.
+ * @see gpioEventFilter()
+ * @return number of events queued, 0 on timeout and -1 if it fails.
+ */
+
+int gpioEventWait(const int timeout_ms)
+{
+  struct epoll_event ev[MAX_EVENT_PINS];
+  uint64_t now, end, due;
+  GPIOWatch_t *watch;
+  int i, n, wait, value, count = 0;
+
+  if (fdEpoll < 0)
+    return -1;
+
+  now = gpioClockNs(CLOCK_MONOTONIC);
+  end = now + (uint64_t) timeout_ms * 1000000ULL;
+
+  do {
+    /* Wake up for the earliest pending filter time */
+    wait = timeout_ms;
+    if (timeout_ms >= 0)
+      wait = (end > now) ? (end - now + 999999) / 1000000 : 0;
+    for (i = 0; i < MAX_EVENT_PINS; i++) {
+      due = watches[i].due;
+      if ((watches[i].fd < 0) || !due)
+        continue;
+      due = (due > now) ? (due - now + 999999) / 1000000 : 0;
+      if ((wait < 0) || (due < (uint64_t) wait))
+        wait = due;
+    }
+
+    n = epoll_wait(fdEpoll, ev, MAX_EVENT_PINS, wait);
+    if (n < 0)
+      return -1;
+
+    now = gpioClockNs(CLOCK_MONOTONIC);
+
+    for (i = 0; i < n; i++) {
+      watch = &watches[ev[i].data.u32];
+
+      value = gpioEventLevel(watch->fd);
+      if (value < 0)
+        continue;
+
+      count += gpioEventFilterEdge(watch, value, now);
+    }
+
+    count += gpioEventFilterDue(now);
+  } while ((count == 0) && ((timeout_ms < 0) || (now < end)));
+
+  return count;
+}
+
+/**
+ * It takes an array of GPIOEvent_t and the size of the array and
+ * moves up to that many of the oldest queued events into it.
+ * @param events a GPIOEvent_t array argument.
+ * @param max a constant integer argument.
+ * @return number of events copied.
+ */
+
+int gpioEventRead(GPIOEvent_t events[], const int max)
+{
+  unsigned int tail = queueTail;
+  unsigned int head = __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE);
+  int count = 0;
+
+  while ((tail != head) && (count < max)) {
+    events[count++] = queue[tail & (GPIO_EVENT_QUEUE_SIZE - 1)];
+    tail++;
+  }
+
+  __atomic_store_n(&queueTail, tail, __ATOMIC_RELEASE);
+  return count;
+}
+
+/**
+ * It returns the number of events dropped because the event queue was full.
+ * @return number of dropped events.
+ */
+
+unsigned int gpioEventDropped(void)
+{
+  return queueDropped;
+}
+
+/**
+ * For closing all watched value files and the epoll file descriptor.
+ */
+
+void gpioEventClose(void)
+{
+  int i;
+
+  if (fdEpoll < 0)
+    return;
+
+  for (i = 0; i < MAX_EVENT_PINS; i++) {
+    if (watches[i].fd >= 0) {
+      close(watches[i].fd);
+      watches[i].fd = -1;
+    }
+  }
+
+  close(fdEpoll);
+  fdEpoll = -1;
+  queueHead = queueTail = 0;
+  queueDropped = 0;
+}
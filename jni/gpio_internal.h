@@ -0,0 +1,69 @@
+/**********************************************************
+  Internal GPIO definitions shared by the GPIO modules
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_internal.h
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Internal GPIO definitions shared by the GPIO modules
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#ifndef __GPIO_INTERNAL_H__
+#define __GPIO_INTERNAL_H__
+
+#define TOTAL_PINS_PER_HEADER 46		/**< Total number of pins per header in beaglebone black */
+#define GPIO_DATA_OUT_REG     0x13C		/**< GPIO DATA OUT register address */
+#define GPIO_DATA_IN_REG      0x138		/**< GPIO DATA IN register address */
+#define GPIO_OE_REG           0x134		/**< GPIO OE register address */
+#define GPIO_CLEARDATAOUT_REG 0x190		/**< GPIO CLEAR DATA OUT register address */
+#define GPIO_SETDATAOUT_REG   0x194		/**< GPIO SET DATA OUT register address */
+#ifndef SYSFS_GPIO_DIR
+#define SYSFS_GPIO_DIR        "/sys/class/gpio"		/**< File system path to access GPIO, the host tests use a fake tree */
+#endif
+#define MAX_GPIO_ID           128		/**< Number of GPIO ids across the four banks */
+#define GPIO_BANKS            4			/**< Number of GPIO register banks */
+
+/** 
+ * typedef struct GPIOBit_t for storing parameters to access GPIOs using Memory Map.
+ * 
+ */
+
+typedef struct {
+  unsigned int id;    /**< FS: ID is the file for the pin */
+  unsigned char bank; /**< MMAP: GPIO bank determines register */
+  unsigned int mask;  /**< MMAP: Mask determines bit in register */
+  unsigned short pad; /**< PINMUX: conf_ register offset from the pad block at 0x44E10800, as used in the DTS */
+} GPIOBit_t;
+
+/** Memory mapped GPIO bank registers, valid after openGPIO(1) */
+extern volatile uint32_t *mapGPIO[GPIO_BANKS];
+
+extern const GPIOBit_t *getGPIOPin(const unsigned int header, const unsigned int pin);
+extern int gpioMmapReady(void);
+extern void gpioSetOE(const unsigned int bank, const uint32_t lines, const uint32_t inputs);
+extern int gpioRealtimeThread(const int cpu);
+extern int gpioEventWatch(const int epfd, const GPIOBit_t *pinGPIO, const uint32_t data, int *level);
+extern int gpioEventLevel(const int fd);
+
+/**
+ * It returns the current time of the given clock in nano seconds.
+ * @param clock a constant clockid_t argument.
+ * @return time in nano seconds.
+ */
+
+static inline uint64_t gpioClockNs(const clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* __GPIO_INTERNAL_H__ */
@@ -0,0 +1,284 @@
+/**********************************************************
+  Matrix keypad scanning code over mmap() access of
+    GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_keypad.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Matrix keypad scanning code over mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_KEYPAD_LINES      16	/**< Maximum number of rows and of columns */
+#define KEYPAD_QUEUE_SIZE     64	/**< Number of key events held in the queue, must be a power of two */
+#define KEYPAD_SETTLE_NS      5000	/**< Time for the columns to settle after driving a row */
+
+static const GPIOBit_t *rowPin[MAX_KEYPAD_LINES];	/**< Pin information of each row */
+static const GPIOBit_t *colPin[MAX_KEYPAD_LINES];	/**< Pin information of each column */
+static int keypadRows = 0;	/**< Number of rows */
+static int keypadCols = 0;	/**< Number of columns */
+static uint32_t rowMask[GPIO_BANKS];	/**< Row pins of each bank */
+static uint32_t colMask[GPIO_BANKS];	/**< Column pins of each bank */
+static uint32_t keypadScan = 10000000;	/**< Scan period in nano seconds */
+static int keypadDebounce = 3;	/**< Scans a key has to read the same before it changes */
+static uint16_t keyState[MAX_KEYPAD_LINES];	/**< Debounced pressed columns of each row */
+static uint8_t keyCount[MAX_KEYPAD_LINES][MAX_KEYPAD_LINES];	/**< Scans each key read differently from its state */
+static volatile int keypadRunning = 0;	/**< Cleared to stop the scanner thread */
+static pthread_t keypadThread;	/**< Scanner thread */
+
+static GPIOKeyEvent_t queue[KEYPAD_QUEUE_SIZE];	/**< Key event queue */
+static unsigned int queueHead = 0;	/**< Index of the next event written by the scanner thread */
+static unsigned int queueTail = 0;	/**< Index of the next event drained by gpioKeypadRead() */
+static unsigned int queueDropped = 0;	/**< Number of events dropped because the queue was full */
+
+/**
+ * This function busy-waits for the columns to settle after driving the rows.
+ */
+
+static void keypadSettle(void)
+{
+  uint64_t deadline = gpioClockNs(CLOCK_MONOTONIC_RAW) + KEYPAD_SETTLE_NS;
+
+  while (gpioClockNs(CLOCK_MONOTONIC_RAW) < deadline)
+    ;
+}
+
+/**
+ * This function drives the given rows low and releases all other rows as inputs, with one OE store per bank.
+ * The rows are open drain: their DATA OUT bits stay low, so two pressed keys in a column never
+ * connect a row driven high to a row driven low.
+ * @param low a constant uint32_t array argument, row pins of each bank to drive low.
+ */
+
+static void keypadDrive(const uint32_t low[GPIO_BANKS])
+{
+  int i;
+
+  for (i = 0; i < GPIO_BANKS; i++)
+    if (rowMask[i])
+      gpioSetOE(i, rowMask[i], rowMask[i] & ~low[i]);
+}
+
+/**
+ * This function reads the columns with one DATA IN read per bank.
+ * @return bit c set if column c reads low.
+ */
+
+static uint16_t keypadColumns(void)
+{
+  uint32_t reg[GPIO_BANKS];
+  uint16_t pressed = 0;
+  int i;
+
+  for (i = 0; i < GPIO_BANKS; i++)
+    if (colMask[i])
+      reg[i] = mapGPIO[i][GPIO_DATA_IN_REG/4];
+
+  for (i = 0; i < keypadCols; i++)
+    if (!(reg[colPin[i]->bank] & colPin[i]->mask))
+      pressed |= 1 << i;
+
+  return pressed;
+}
+
+/**
+ * This is the scanner thread. Each scan first drives all rows low at once and reads the columns;
+ * when no key reads pressed and no key is held or changing, the scan ends there. Otherwise
+ * the rows are driven low one by one and every key is debounced.
+ * @param arg a void pointer argument, unused.
+ * @return NULL
+ */
+
+static void *keypadScanThread(void *arg)
+{
+  uint32_t low[GPIO_BANKS];
+  struct timespec ts;
+  uint64_t next;
+  uint16_t raw, changed;
+  unsigned int head;
+  int active = 0, r, c;
+
+  next = gpioClockNs(CLOCK_MONOTONIC);
+
+  while (keypadRunning) {
+    next += keypadScan;
+    ts.tv_sec = next / 1000000000ULL;
+    ts.tv_nsec = next % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+    if (!active) {
+      keypadDrive(rowMask);
+      keypadSettle();
+      if (!keypadColumns())
+        continue;
+    }
+
+    active = 0;
+    for (r = 0; r < keypadRows; r++) {
+      memset(low, 0, sizeof(low));
+      low[rowPin[r]->bank] = rowPin[r]->mask;
+      keypadDrive(low);
+      keypadSettle();
+      raw = keypadColumns();
+
+      changed = raw ^ keyState[r];
+      for (c = 0; c < keypadCols; c++) {
+        if (!(changed & (1 << c))) {
+          keyCount[r][c] = 0;
+          continue;
+        }
+
+        active = 1;
+        if (++keyCount[r][c] < keypadDebounce)
+          continue;
+
+        keyCount[r][c] = 0;
+        keyState[r] ^= 1 << c;
+
+        head = queueHead;
+        if (head - __atomic_load_n(&queueTail, __ATOMIC_ACQUIRE) >= KEYPAD_QUEUE_SIZE) {
+          queueDropped++;
+          continue;
+        }
+        queue[head & (KEYPAD_QUEUE_SIZE - 1)].row = r;
+        queue[head & (KEYPAD_QUEUE_SIZE - 1)].col = c;
+        queue[head & (KEYPAD_QUEUE_SIZE - 1)].down = (keyState[r] >> c) & 1;
+        queue[head & (KEYPAD_QUEUE_SIZE - 1)].timestamp = next;
+        __atomic_store_n(&queueHead, head + 1, __ATOMIC_RELEASE);
+      }
+
+      if (keyState[r])
+        active = 1;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * It takes the GPIO headers and pins of the rows and columns of a key matrix and starts scanning it.
+ * Rows are driven open drain, low one at a time and released as inputs otherwise; columns are
+ * inputs and need pull-ups, see gpioPadSet(). A pressed key reads low on its column while its row is driven.
+ * GPIO has to be opened with memory map access.
+ * @param rowHeaders a constant unsigned int array argument.
+ * @param rowPins a constant unsigned int array argument.
+ * @param rows a constant integer argument, at most 16.
+ * @param colHeaders a constant unsigned int array argument.
+ * @param colPins a constant unsigned int array argument.
+ * @param cols a constant integer argument, at most 16.
+ * @param scan_us a constant uint32_t argument, scan period in micro seconds.
+ * @param debounce a constant integer argument, number of scans a key has to read the same before it changes.
+ * @see gpioKeypadRead()
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioKeypadStart(const unsigned int rowHeaders[], const unsigned int rowPins[], const int rows,
+  const unsigned int colHeaders[], const unsigned int colPins[], const int cols,
+  const uint32_t scan_us, const int debounce)
+{
+  int i;
+
+  if (keypadRunning || (rows <= 0) || (rows > MAX_KEYPAD_LINES) || (cols <= 0) ||
+      (cols > MAX_KEYPAD_LINES) || (scan_us == 0) || (debounce <= 0) || (debounce > 255) ||
+      !gpioMmapReady())
+    return -1;
+
+  memset(rowMask, 0, sizeof(rowMask));
+  memset(colMask, 0, sizeof(colMask));
+
+  for (i = 0; i < rows; i++) {
+    rowPin[i] = getGPIOPin(rowHeaders[i], rowPins[i]);
+    if ((rowPin[i] == NULL) || gpioSetDirection(rowHeaders[i], rowPins[i], GPIO_DIRECTION_INPUT))
+      return -1;
+    rowMask[rowPin[i]->bank] |= rowPin[i]->mask;
+  }
+
+  for (i = 0; i < cols; i++) {
+    colPin[i] = getGPIOPin(colHeaders[i], colPins[i]);
+    if ((colPin[i] == NULL) || gpioSetDirection(colHeaders[i], colPins[i], GPIO_DIRECTION_INPUT))
+      return -1;
+    colMask[colPin[i]->bank] |= colPin[i]->mask;
+  }
+
+  /* A row only ever drives low, selecting it just clears its OE bit */
+  for (i = 0; i < GPIO_BANKS; i++)
+    if (rowMask[i])
+      mapGPIO[i][GPIO_CLEARDATAOUT_REG/4] = rowMask[i];
+
+  keypadRows = rows;
+  keypadCols = cols;
+  keypadScan = scan_us * 1000;
+  keypadDebounce = debounce;
+  memset(keyState, 0, sizeof(keyState));
+  memset(keyCount, 0, sizeof(keyCount));
+  queueHead = queueTail = queueDropped = 0;
+
+  keypadRunning = 1;
+  if (pthread_create(&keypadThread, NULL, keypadScanThread, NULL) != 0) {
+    keypadRunning = 0;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * It takes an array of GPIOKeyEvent_t and the size of the array and
+ * moves up to that many of the oldest key presses and releases into it.
+ * @param events a GPIOKeyEvent_t array argument.
+ * @param max a constant integer argument.
+ * @return number of events copied.
+ */
+
+int gpioKeypadRead(GPIOKeyEvent_t events[], const int max)
+{
+  unsigned int tail = queueTail;
+  unsigned int head = __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE);
+  int count = 0;
+
+  while ((tail != head) && (count < max)) {
+    events[count++] = queue[tail & (KEYPAD_QUEUE_SIZE - 1)];
+    tail++;
+  }
+
+  __atomic_store_n(&queueTail, tail, __ATOMIC_RELEASE);
+  return count;
+}
+
+/**
+ * It returns the number of key events dropped because the queue was full.
+ * @return number of dropped events.
+ */
+
+unsigned int gpioKeypadDropped(void)
+{
+  return queueDropped;
+}
+
+/**
+ * For stopping the scanner thread. All rows are left released as inputs.
+ */
+
+void gpioKeypadStop(void)
+{
+  uint32_t none[GPIO_BANKS] = { 0, 0, 0, 0 };
+
+  if (!keypadRunning)
+    return;
+
+  keypadRunning = 0;
+  pthread_join(keypadThread, NULL);
+  keypadDrive(none);
+}
@@ -0,0 +1,447 @@
+/**********************************************************
+  1-Wire bus master code bit-banged over mmap() access
+    of GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_onewire.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief 1-Wire bus master code bit-banged over mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_ONEWIRE_BUSES    4		/**< Maximum number of 1-Wire buses open at once */
+#define MAX_ONEWIRE_DEVICES  64		/**< Maximum number of devices cached per bus */
+
+#define ONEWIRE_SEARCH_ROM   0xF0	/**< Search ROM command */
+#define ONEWIRE_MATCH_ROM    0x55	/**< Match ROM command */
+#define ONEWIRE_SKIP_ROM     0xCC	/**< Skip ROM command, addresses all devices */
+#define DS18B20_CONVERT_T    0x44	/**< Start temperature conversion command */
+#define DS18B20_READ_SCRATCH 0xBE	/**< Read scratchpad command */
+#define DS18B20_CONVERT_MS   750	/**< Worst case conversion time at 12 bit resolution */
+#define DS18B20_POLL_MS      10		/**< Interval between checks for the end of a conversion */
+#define DS18S20_FAMILY       0x10	/**< Family code of the DS18S20, whose temperature has a 0.5 degree step */
+#define DS18B20_READ_TRIES   3		/**< Attempts at reading a scratchpad before giving up on a device */
+
+/**
+ * typedef struct GPIOOneWire_t for storing the state of one 1-Wire bus.
+ * The line is driven open drain: low by enabling the output with DATA OUT cleared,
+ * and released by turning the pin back into an input so the pull-up raises it.
+ * OE goes through gpioSetOE() so gpio.c keeps track of the direction.
+ */
+
+typedef struct {
+  int used;                                     /**< Non zero if the bus is open */
+  unsigned int bank;                            /**< Bank of the line */
+  volatile uint32_t *in;                        /**< DATA IN register of the line's bank */
+  uint32_t mask;                                /**< Bit of the line in its bank */
+  int count;                                    /**< Number of cached ROM ids */
+  uint8_t rom[MAX_ONEWIRE_DEVICES][8];          /**< ROM ids found by oneWireSearch() */
+} GPIOOneWire_t;
+
+static GPIOOneWire_t wires[MAX_ONEWIRE_BUSES];	/**< 1-Wire buses */
+
+/**
+ * This function busy-waits for the given number of micro seconds.
+ * @param us a constant uint32_t argument.
+ */
+
+static void delayUs(const uint32_t us)
+{
+  uint64_t deadline = gpioClockNs(CLOCK_MONOTONIC_RAW) + us * 1000ULL;
+
+  while (gpioClockNs(CLOCK_MONOTONIC_RAW) < deadline)
+    ;
+}
+
+/**
+ * This function pulls the line low.
+ * @param w a constant GPIOOneWire_t pointer argument.
+ */
+
+static inline void lineLow(const GPIOOneWire_t *w)
+{
+  gpioSetOE(w->bank, w->mask, 0);
+}
+
+/**
+ * This function releases the line so the pull-up raises it.
+ * @param w a constant GPIOOneWire_t pointer argument.
+ */
+
+static inline void lineRelease(const GPIOOneWire_t *w)
+{
+  gpioSetOE(w->bank, w->mask, w->mask);
+}
+
+/**
+ * This function returns the id of an open bus or NULL for an invalid id.
+ * @param id a constant integer argument.
+ * @return pointer to the bus or NULL.
+ */
+
+static GPIOOneWire_t *getWire(const int id)
+{
+  if ((id < 0) || (id >= MAX_ONEWIRE_BUSES) || !wires[id].used)
+    return NULL;
+
+  return &wires[id];
+}
+
+/**
+ * It takes the GPIO header and pin of a 1-Wire line with an external pull-up and opens a bus on it.
+ * GPIO has to be opened with memory map access. The slots are timed by busy-waiting on the
+ * calling thread, and a slot preempted while the line is low turns into a write 0 or a
+ * reset, so the bus should be used from a thread pinned to a CPU at SCHED_FIFO priority.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return bus id on success and -1 if it fails.
+ */
+
+int oneWireOpen(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO;
+  GPIOOneWire_t *w;
+  int id;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if ((pinGPIO == NULL) || !gpioMmapReady())
+    return -1;
+
+  for (id = 0; id < MAX_ONEWIRE_BUSES; id++)
+    if (!wires[id].used)
+      break;
+  if (id == MAX_ONEWIRE_BUSES)
+    return -1;
+
+  if (gpioSetDirection(header, pin, GPIO_DIRECTION_INPUT))
+    return -1;
+
+  w = &wires[id];
+  memset(w, 0, sizeof(*w));
+  w->bank = pinGPIO->bank;
+  w->in = &mapGPIO[pinGPIO->bank][GPIO_DATA_IN_REG/4];
+  w->mask = pinGPIO->mask;
+
+  /* The output latch stays low, only OE toggles the line */
+  mapGPIO[pinGPIO->bank][GPIO_CLEARDATAOUT_REG/4] = pinGPIO->mask;
+
+  w->used = 1;
+  return id;
+}
+
+/**
+ * It sends a reset pulse on a bus and checks for a presence pulse.
+ * @param id a constant integer argument.
+ * @return 1 if a device answered, 0 if none did and -1 if it fails.
+ */
+
+int oneWireReset(const int id)
+{
+  GPIOOneWire_t *w = getWire(id);
+  int present;
+
+  if (w == NULL)
+    return -1;
+
+  lineLow(w);
+  delayUs(480);
+  lineRelease(w);
+  delayUs(70);
+  present = !(*w->in & w->mask);
+  delayUs(410);
+
+  return present;
+}
+
+/**
+ * This function writes one time slot.
+ * @param w a constant GPIOOneWire_t pointer argument.
+ * @param bit a constant integer argument.
+ */
+
+static void writeBit(const GPIOOneWire_t *w, const int bit)
+{
+  lineLow(w);
+  if (bit) {
+    delayUs(6);
+    lineRelease(w);
+    delayUs(64);
+  } else {
+    delayUs(60);
+    lineRelease(w);
+    delayUs(10);
+  }
+}
+
+/**
+ * This function reads one time slot.
+ * @param w a constant GPIOOneWire_t pointer argument.
+ * @return value of the bit.
+ */
+
+static int readBit(const GPIOOneWire_t *w)
+{
+  int bit;
+
+  lineLow(w);
+  delayUs(6);
+  lineRelease(w);
+  delayUs(9);
+  bit = (*w->in & w->mask) != 0;
+  delayUs(55);
+
+  return bit;
+}
+
+/**
+ * It writes a byte to a bus, least significant bit first.
+ * @param id a constant integer argument.
+ * @param byte a constant uint8_t argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int oneWireWriteByte(const int id, const uint8_t byte)
+{
+  GPIOOneWire_t *w = getWire(id);
+  int i;
+
+  if (w == NULL)
+    return -1;
+
+  for (i = 0; i < 8; i++)
+    writeBit(w, (byte >> i) & 1);
+
+  return 0;
+}
+
+/**
+ * It reads a byte from a bus, least significant bit first.
+ * @param id a constant integer argument.
+ * @return value of the byte on success and -1 if it fails.
+ */
+
+int oneWireReadByte(const int id)
+{
+  GPIOOneWire_t *w = getWire(id);
+  int i, byte = 0;
+
+  if (w == NULL)
+    return -1;
+
+  for (i = 0; i < 8; i++)
+    byte |= readBit(w) << i;
+
+  return byte;
+}
+
+/**
+ * This function computes the Dallas/Maxim CRC8 of a buffer.
+ * @param data a constant uint8_t array argument.
+ * @param len a constant integer argument.
+ * @return CRC8 of the buffer, 0 if the buffer ends with its correct CRC.
+ */
+
+static uint8_t crc8(const uint8_t data[], const int len)
+{
+  uint8_t crc = 0, byte;
+  int i, bit;
+
+  for (i = 0; i < len; i++) {
+    byte = data[i];
+    for (bit = 0; bit < 8; bit++) {
+      crc = ((crc ^ byte) & 1) ? (crc >> 1) ^ 0x8C : (crc >> 1);
+      byte >>= 1;
+    }
+  }
+
+  return crc;
+}
+
+/**
+ * It runs the ROM search algorithm on a bus and caches the ROM ids of all devices found.
+ * @param id a constant integer argument.
+ * @see oneWireGetRom()
+ * @return number of devices found and -1 if it fails.
+ */
+
+int oneWireSearch(const int id)
+{
+  GPIOOneWire_t *w = getWire(id);
+  uint8_t rom[8];
+  int lastDiscrepancy = 0, discrepancy, bitIndex, idBit, cmpBit, dir;
+
+  if (w == NULL)
+    return -1;
+
+  w->count = 0;
+  memset(rom, 0, sizeof(rom));
+
+  do {
+    if (oneWireReset(id) != 1)
+      break;
+
+    oneWireWriteByte(id, ONEWIRE_SEARCH_ROM);
+    discrepancy = 0;
+
+    for (bitIndex = 1; bitIndex <= 64; bitIndex++) {
+      idBit = readBit(w);
+      cmpBit = readBit(w);
+
+      if (idBit && cmpBit)
+        return w->count; /* No device answered */
+
+      if (idBit != cmpBit) {
+        dir = idBit;
+      } else {
+        /* Devices disagree: take the 1 branch at the last discrepancy, 0 past it and repeat the old path before it */
+        if (bitIndex == lastDiscrepancy)
+          dir = 1;
+        else if (bitIndex > lastDiscrepancy)
+          dir = 0;
+        else
+          dir = (rom[(bitIndex - 1) / 8] >> ((bitIndex - 1) % 8)) & 1;
+
+        if (dir == 0)
+          discrepancy = bitIndex;
+      }
+
+      if (dir)
+        rom[(bitIndex - 1) / 8] |= 1 << ((bitIndex - 1) % 8);
+      else
+        rom[(bitIndex - 1) / 8] &= ~(1 << ((bitIndex - 1) % 8));
+
+      writeBit(w, dir);
+    }
+
+    if (crc8(rom, 8) == 0)
+      memcpy(w->rom[w->count++], rom, 8);
+
+    lastDiscrepancy = discrepancy;
+  } while (lastDiscrepancy && (w->count < MAX_ONEWIRE_DEVICES));
+
+  return w->count;
+}
+
+/**
+ * It copies a ROM id cached by oneWireSearch().
+ * @param id a constant integer argument.
+ * @param index a constant integer argument.
+ * @param rom a uint8_t array argument of 8 bytes.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int oneWireGetRom(const int id, const int index, uint8_t rom[8])
+{
+  GPIOOneWire_t *w = getWire(id);
+
+  if ((w == NULL) || (index < 0) || (index >= w->count))
+    return -1;
+
+  memcpy(rom, w->rom[index], 8);
+  return 0;
+}
+
+/**
+ * This function converts the temperature in a scratchpad to milli degrees Celsius.
+ * @param family a constant uint8_t argument, family code of the device.
+ * @param scratch a constant uint8_t array argument, scratchpad of the device.
+ * @return temperature in milli degrees Celsius.
+ */
+
+static int32_t scratchTemperature(const uint8_t family, const uint8_t scratch[9])
+{
+  int32_t raw = (int16_t) (scratch[1] << 8 | scratch[0]);
+
+  if (family != DS18S20_FAMILY)
+    return raw * 1000 / 16;
+
+  /* Half degree reading without COUNT PER C, else the extended resolution of the datasheet */
+  if (scratch[7] == 0)
+    return raw * 500;
+
+  return (raw >> 1) * 1000 - 250 + (scratch[7] - scratch[6]) * 1000 / scratch[7];
+}
+
+/**
+ * It reads the temperature of every DS18B20 class device cached by oneWireSearch().
+ * One broadcast convert command starts the conversion on all devices at once, so a sweep
+ * of the whole bus takes one conversion time instead of one per device. DS18S20 devices
+ * report half degrees, refined with the count remain byte of their scratchpad.
+ * A scratchpad that fails the CRC, for instance because a slot was preempted, is read again
+ * up to DS18B20_READ_TRIES times.
+ * @param id a constant integer argument.
+ * @param milliCelsius an int32_t array argument that receives the temperature of each cached device.
+ * @param max a constant integer argument, size of the array.
+ * @return number of temperatures read and -1 if it fails. Devices whose scratchpad keeps failing the CRC get INT32_MIN.
+ */
+
+int oneWireReadTemperatures(const int id, int32_t milliCelsius[], const int max)
+{
+  GPIOOneWire_t *w = getWire(id);
+  struct timespec ts = { 0, DS18B20_POLL_MS * 1000000L };
+  uint8_t scratch[9];
+  int n, i, tries, count;
+
+  if ((w == NULL) || (milliCelsius == NULL) || (max < 0))
+    return -1;
+
+  if (oneWireReset(id) != 1)
+    return -1;
+  oneWireWriteByte(id, ONEWIRE_SKIP_ROM);
+  oneWireWriteByte(id, DS18B20_CONVERT_T);
+
+  /* Devices answer read slots with 0 while converting, so stop waiting as soon as they are all done */
+  for (i = 0; i < DS18B20_CONVERT_MS; i += DS18B20_POLL_MS) {
+    nanosleep(&ts, NULL);
+    if (readBit(w))
+      break;
+  }
+
+  count = (w->count < max) ? w->count : max;
+  for (n = 0; n < count; n++) {
+    milliCelsius[n] = INT32_MIN;
+    for (tries = 0; tries < DS18B20_READ_TRIES; tries++) {
+      oneWireReset(id);
+      oneWireWriteByte(id, ONEWIRE_MATCH_ROM);
+      for (i = 0; i < 8; i++)
+        oneWireWriteByte(id, w->rom[n][i]);
+      oneWireWriteByte(id, DS18B20_READ_SCRATCH);
+      for (i = 0; i < 9; i++)
+        scratch[i] = oneWireReadByte(id);
+
+      if (crc8(scratch, 9) == 0) {
+        milliCelsius[n] = scratchTemperature(w->rom[n][0], scratch);
+        break;
+      }
+    }
+  }
+
+  return count;
+}
+
+/**
+ * For closing a 1-Wire bus. The line is left released.
+ * @param id a constant integer argument.
+ */
+
+void oneWireClose(const int id)
+{
+  GPIOOneWire_t *w = getWire(id);
+
+  if (w == NULL)
+    return;
+
+  lineRelease(w);
+  w->used = 0;
+}
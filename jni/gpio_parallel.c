@@ -0,0 +1,243 @@
+/**********************************************************
+  Parallel bus writer code scattering words onto GPIO pins
+    over mmap() access of GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_parallel.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Parallel bus writer code scattering words onto GPIO pins over mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_PARALLEL_PINS 32	/**< Maximum width of a parallel bus in bits */
+#define PARALLEL_LANES    (MAX_PARALLEL_PINS / 8)	/**< Number of byte lookup tables */
+
+/**
+ * typedef struct GPIOParallelEntry_t for the bank stores of one byte value of one lane.
+ */
+
+typedef struct {
+  uint32_t set[GPIO_BANKS];     /**< Bits to store in SET DATA OUT of each bank */
+  uint32_t clear[GPIO_BANKS];   /**< Bits to store in CLEAR DATA OUT of each bank */
+} GPIOParallelEntry_t;
+
+/**
+ * struct GPIOParallel for a parallel bus created by gpioParallelCreate().
+ */
+
+struct GPIOParallel {
+  int width;                                      /**< Number of data pins */
+  int lanes;                                      /**< Number of bytes of a word in use */
+  GPIOParallelEntry_t lut[PARALLEL_LANES][256];   /**< Bank stores for each byte value of each lane */
+  volatile uint32_t *strobeAssert;                /**< Register asserting the strobe, NULL without strobe */
+  volatile uint32_t *strobeRelease;               /**< Register releasing the strobe */
+  uint32_t strobeMask;                            /**< Bit of the strobe pin in its bank */
+};
+
+/**
+ * This function busy-waits until the given CLOCK_MONOTONIC_RAW time.
+ * @param deadline a constant uint64_t argument, time in nano seconds.
+ */
+
+static inline void spinUntil(const uint64_t deadline)
+{
+  while (gpioClockNs(CLOCK_MONOTONIC_RAW) < deadline)
+    ;
+}
+
+/**
+ * This function drives a word onto the data pins of a bus.
+ * @param bus a constant GPIOParallel_t pointer argument.
+ * @param word a constant uint32_t argument.
+ */
+
+static inline void parallelWrite(const GPIOParallel_t *bus, const uint32_t word)
+{
+  uint32_t set[GPIO_BANKS] = { 0, 0, 0, 0 };
+  uint32_t clear[GPIO_BANKS] = { 0, 0, 0, 0 };
+  const GPIOParallelEntry_t *entry;
+  int lane, i;
+
+  for (lane = 0; lane < bus->lanes; lane++) {
+    entry = &bus->lut[lane][(word >> (lane * 8)) & 0xFF];
+    for (i = 0; i < GPIO_BANKS; i++) {
+      set[i] |= entry->set[i];
+      clear[i] |= entry->clear[i];
+    }
+  }
+
+  for (i = 0; i < GPIO_BANKS; i++) {
+    if (set[i])
+      mapGPIO[i][GPIO_SETDATAOUT_REG/4] = set[i];
+    if (clear[i])
+      mapGPIO[i][GPIO_CLEARDATAOUT_REG/4] = clear[i];
+  }
+}
+
+/**
+ * It takes arrays of GPIO headers and pins of the data lines, least significant bit first,
+ * and builds a parallel bus on them. For every byte of a word the set and clear masks of
+ * each bank are precomputed for all 256 values, so writing a word is a table lookup per
+ * byte and at most one SET DATA OUT and one CLEAR DATA OUT store per bank.
+ * GPIO has to be opened with memory map access. All pins are made outputs, the data pins
+ * low and the strobe released.
+ * @param headers a constant unsigned int array argument.
+ * @param pins a constant unsigned int array argument.
+ * @param count a constant integer argument, at most 32.
+ * @param strobeHeader a constant unsigned int argument, header of the strobe pin or 0 for none.
+ * @param strobePin a constant unsigned int argument, pin of the strobe pin.
+ * @param strobeActiveLow a constant integer argument, non zero if the strobe pulses low.
+ * @see gpioParallelWrite()
+ * @see gpioParallelStream()
+ * @return pointer to the bus on success and NULL if it fails.
+ */
+
+GPIOParallel_t *gpioParallelCreate(const unsigned int headers[], const unsigned int pins[],
+  const int count, const unsigned int strobeHeader, const unsigned int strobePin,
+  const int strobeActiveLow)
+{
+  const GPIOBit_t *pinGPIO[MAX_PARALLEL_PINS];
+  const GPIOBit_t *strobeGPIO;
+  GPIOParallelEntry_t *entry;
+  GPIOParallel_t *bus;
+  int i, lane, value, bit;
+
+  if ((count <= 0) || (count > MAX_PARALLEL_PINS) || !gpioMmapReady())
+    return NULL;
+
+  for (i = 0; i < count; i++) {
+    pinGPIO[i] = getGPIOPin(headers[i], pins[i]);
+    if (pinGPIO[i] == NULL)
+      return NULL;
+  }
+
+  strobeGPIO = NULL;
+  if (strobeHeader) {
+    strobeGPIO = getGPIOPin(strobeHeader, strobePin);
+    if (strobeGPIO == NULL)
+      return NULL;
+  }
+
+  bus = (GPIOParallel_t *) calloc(1, sizeof(GPIOParallel_t));
+  if (bus == NULL)
+    return NULL;
+
+  bus->width = count;
+  bus->lanes = (count + 7) / 8;
+
+  for (lane = 0; lane < bus->lanes; lane++) {
+    for (value = 0; value < 256; value++) {
+      entry = &bus->lut[lane][value];
+      for (bit = 0; bit < 8; bit++) {
+        i = lane * 8 + bit;
+        if (i >= count)
+          break;
+        if (value & (1 << bit))
+          entry->set[pinGPIO[i]->bank] |= pinGPIO[i]->mask;
+        else
+          entry->clear[pinGPIO[i]->bank] |= pinGPIO[i]->mask;
+      }
+    }
+  }
+
+  if (strobeGPIO != NULL) {
+    bus->strobeAssert = &mapGPIO[strobeGPIO->bank][strobeActiveLow ?
+      GPIO_CLEARDATAOUT_REG/4 : GPIO_SETDATAOUT_REG/4];
+    bus->strobeRelease = &mapGPIO[strobeGPIO->bank][strobeActiveLow ?
+      GPIO_SETDATAOUT_REG/4 : GPIO_CLEARDATAOUT_REG/4];
+    bus->strobeMask = strobeGPIO->mask;
+    *bus->strobeRelease = bus->strobeMask;
+  }
+
+  /* The strobe release and the idle data levels are in DATA OUT before the outputs are enabled */
+  parallelWrite(bus, 0);
+
+  if ((strobeGPIO != NULL) &&
+      gpioSetDirection(strobeHeader, strobePin, GPIO_DIRECTION_OUTPUT)) {
+    free(bus);
+    return NULL;
+  }
+
+  for (i = 0; i < count; i++) {
+    if (gpioSetDirection(headers[i], pins[i], GPIO_DIRECTION_OUTPUT)) {
+      free(bus);
+      return NULL;
+    }
+  }
+
+  return bus;
+}
+
+/**
+ * It takes a bus created by gpioParallelCreate() and drives a word onto its data pins.
+ * Bit i of the word goes to data pin i. The strobe is not touched.
+ * @param bus a constant GPIOParallel_t pointer argument.
+ * @param word a constant uint32_t argument.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+int gpioParallelWrite(const GPIOParallel_t *bus, const uint32_t word)
+{
+  if (bus == NULL)
+    return 1;
+
+  parallelWrite(bus, word);
+  return 0;
+}
+
+/**
+ * It takes a bus created by gpioParallelCreate() with a strobe pin and writes a buffer of words,
+ * pulsing the strobe after each one. The data is set up before the strobe is asserted and held
+ * until after it is released.
+ * @param bus a constant GPIOParallel_t pointer argument.
+ * @param words a constant uint32_t array argument.
+ * @param count a constant integer argument.
+ * @param pulse_ns a constant uint32_t argument, strobe pulse width and hold time in nano seconds, 0 for as fast as possible.
+ * @return 0 if successfull and 1 if it fails
+ */
+
+int gpioParallelStream(const GPIOParallel_t *bus, const uint32_t words[], const int count,
+  const uint32_t pulse_ns)
+{
+  uint64_t deadline = 0;
+  int n;
+
+  if ((bus == NULL) || (bus->strobeAssert == NULL) || (count < 0))
+    return 1;
+
+  for (n = 0; n < count; n++) {
+    parallelWrite(bus, words[n]);
+
+    *bus->strobeAssert = bus->strobeMask;
+    if (pulse_ns) {
+      deadline = gpioClockNs(CLOCK_MONOTONIC_RAW) + pulse_ns;
+      spinUntil(deadline);
+    }
+    *bus->strobeRelease = bus->strobeMask;
+    if (pulse_ns)
+      spinUntil(deadline + pulse_ns);
+  }
+
+  return 0;
+}
+
+/**
+ * For freeing a bus created by gpioParallelCreate().
+ * @param bus a GPIOParallel_t pointer argument.
+ */
+
+void gpioParallelFree(GPIOParallel_t *bus)
+{
+  free(bus);
+}
@@ -0,0 +1,166 @@
+/**********************************************************
+  Pad configuration (pinmux) code for mmap() access of
+    the AM335x control module
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_pinmux.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Pad configuration (pinmux) code for mmap() access of the AM335x control module
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#ifndef PINMUX_MEM_DEV
+#define PINMUX_MEM_DEV      "/dev/mem"	/**< Device mapped for the control module, the host tests map a register file instead */
+#endif
+#define CONTROL_MODULE_ADDR 0x44E10000	/**< Control module register address */
+#define CONTROL_MODULE_SIZE 0x2000		/**< Size of the control module mapping */
+#define CONF_PADS_OFFSET    0x800		/**< Offset of the conf_ pad registers in the control module */
+
+#define PAD_MODE_MASK       0x07		/**< Mux mode bits of a pad register */
+#define PAD_PULL_DISABLE    (1 << 3)	/**< Pad register bit disabling the pull resistor */
+#define PAD_PULL_UP         (1 << 4)	/**< Pad register bit selecting pull-up instead of pull-down */
+#define PAD_RX_ACTIVE       (1 << 5)	/**< Pad register bit enabling the input receiver */
+#define PAD_SLEW_SLOW       (1 << 6)	/**< Pad register bit selecting slow slew rate */
+
+static int fdPinmux = -1;	/**< File descriptor of PINMUX_MEM_DEV for the control module mapping */
+static volatile uint32_t *mapPads = NULL;	/**< Mapped conf_ pad registers */
+
+/**
+ * This function maps the control module registers on first use.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int openPinmux(void)
+{
+  volatile uint8_t *map;
+
+  if (mapPads != NULL)
+    return 0;
+
+  fdPinmux = open(PINMUX_MEM_DEV, O_RDWR | O_SYNC);
+  if (fdPinmux < 0)
+    return -1;
+
+  map = (volatile uint8_t *) mmap(NULL, CONTROL_MODULE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+    fdPinmux, CONTROL_MODULE_ADDR);
+  if (map == (volatile uint8_t *) MAP_FAILED) {
+    printf("PINMUX: errno[%d]: '%s'\n", errno, strerror(errno));
+    close(fdPinmux);
+    fdPinmux = -1;
+    return -1;
+  }
+
+  mapPads = (volatile uint32_t *) (map + CONF_PADS_OFFSET);
+  return 0;
+}
+
+/**
+ * It takes GPIO header and pin and writes a raw value to the pad register of the pin.
+ * The register is read back to check the write, since the control module silently
+ * ignores writes on kernels or SoC revisions that only accept privileged pad writes.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param value a constant uint32_t argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioPadSetRaw(const unsigned int header, const unsigned int pin, const uint32_t value)
+{
+  const GPIOBit_t *pinGPIO;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if ((pinGPIO == NULL) || openPinmux())
+    return -1;
+
+  mapPads[pinGPIO->pad/4] = value;
+
+  if ((mapPads[pinGPIO->pad/4] & 0x7F) != (value & 0x7F))
+    return -1;
+
+  return 0;
+}
+
+/**
+ * It takes GPIO header and pin and returns the raw value of the pad register of the pin.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return value of the pad register on success and -1 if it fails.
+ */
+
+int gpioPadGet(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if ((pinGPIO == NULL) || openPinmux())
+    return -1;
+
+  return mapPads[pinGPIO->pad/4] & 0x7F;
+}
+
+/**
+ * It takes GPIO header, pin and pad settings and configures the pad of the pin.
+ * This replaces recompiling and reloading the cape overlay for changing a pin function.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @param mode a constant integer argument, mux mode 0 to 7 where 7 is GPIO.
+ * @param pull a constant integer argument, one of GPIO_PULL_NONE, GPIO_PULL_DOWN and GPIO_PULL_UP.
+ * @param rxEnable a constant integer argument, non zero enables the input receiver.
+ * @param slowSlew a constant integer argument, non zero selects slow slew rate.
+ * @see gpioPadSetRaw()
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioPadSet(const unsigned int header, const unsigned int pin, const int mode,
+  const int pull, const int rxEnable, const int slowSlew)
+{
+  uint32_t value;
+
+  if ((mode < 0) || (mode > PAD_MODE_MASK))
+    return -1;
+
+  value = mode;
+
+  if (pull == GPIO_PULL_NONE)
+    value |= PAD_PULL_DISABLE;
+  else if (pull == GPIO_PULL_UP)
+    value |= PAD_PULL_UP;
+  else if (pull != GPIO_PULL_DOWN)
+    return -1;
+
+  if (rxEnable)
+    value |= PAD_RX_ACTIVE;
+  if (slowSlew)
+    value |= PAD_SLEW_SLOW;
+
+  return gpioPadSetRaw(header, pin, value);
+}
+
+/**
+ * For unmapping the control module registers.
+ */
+
+void gpioPadClose(void)
+{
+  if (mapPads == NULL)
+    return;
+
+  munmap((void *) (mapPads - CONF_PADS_OFFSET/4), CONTROL_MODULE_SIZE);
+  close(fdPinmux);
+  mapPads = NULL;
+  fdPinmux = -1;
+}
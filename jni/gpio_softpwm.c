@@ -0,0 +1,287 @@
+/**********************************************************
+  Software PWM code for arbitrary GPIO pins over mmap()
+    access of GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_softpwm.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Software PWM code for arbitrary GPIO pins over mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_SOFT_PWM_CHANNELS 64	/**< Maximum number of software PWM channels */
+#define SPIN_THRESHOLD_NS     50000	/**< Waits shorter than this are busy-waited, longer ones sleep first */
+#define SOFT_PWM_FRESH        4		/**< Flag of softPwmMiddle marking a list not picked up yet */
+
+/**
+ * typedef struct GPIOSoftPwmEvent_t for one falling edge time of a period.
+ * All channels with the same duty share one event.
+ */
+
+typedef struct {
+  uint32_t offset;              /**< Time from the start of the period in nano seconds */
+  uint32_t clear[GPIO_BANKS];   /**< Bits driven low in each bank */
+} GPIOSoftPwmEvent_t;
+
+/**
+ * typedef struct GPIOSoftPwmList_t for the event list of one period, sorted by offset.
+ */
+
+typedef struct {
+  uint32_t set[GPIO_BANKS];                             /**< Bits driven high at the start of the period */
+  uint32_t clear[GPIO_BANKS];                           /**< Bits of channels with duty 0 driven low at the start */
+  int count;                                            /**< Number of events */
+  GPIOSoftPwmEvent_t events[MAX_SOFT_PWM_CHANNELS];     /**< Events sorted by offset */
+} GPIOSoftPwmList_t;
+
+static const GPIOBit_t *channels[MAX_SOFT_PWM_CHANNELS];	/**< Pin information of each channel */
+static uint32_t duty[MAX_SOFT_PWM_CHANNELS];	/**< Duty of each channel in nano seconds */
+static int channelCount = 0;	/**< Number of channels */
+static uint32_t softPwmPeriod = 1000000;	/**< Period in nano seconds */
+static int softPwmCpu = -1;	/**< CPU the scheduler thread is pinned to, -1 for any */
+static volatile int softPwmRunning = 0;	/**< Cleared to stop the scheduler thread */
+static pthread_t softPwmThread;	/**< Scheduler thread */
+static pthread_mutex_t softPwmLock = PTHREAD_MUTEX_INITIALIZER;	/**< Serializes writers of the duty */
+
+/**
+ * Event lists are triple buffered: the scheduler runs softPwmFront, writers fill softPwmBack
+ * and exchange it with softPwmMiddle, which the scheduler swaps with its front list at the
+ * start of a period. Neither side ever waits for the other.
+ */
+
+static GPIOSoftPwmList_t lists[3];	/**< Event list buffers */
+static int softPwmBack = 0;	/**< List filled by writers */
+static int softPwmMiddle = 1;	/**< List handed over, with SOFT_PWM_FRESH if not picked up yet */
+static int softPwmFront = 2;	/**< List run by the scheduler thread */
+
+/**
+ * It takes GPIO header and pin and adds a software PWM channel with duty 0.
+ * Channels have to be added before softPwmStart(). The pin is made an output.
+ * @param header a constant unsigned int argument.
+ * @param pin a constant unsigned int argument.
+ * @return channel number on success and -1 if it fails.
+ */
+
+int softPwmAdd(const unsigned int header, const unsigned int pin)
+{
+  const GPIOBit_t *pinGPIO;
+
+  if (softPwmRunning || (channelCount >= MAX_SOFT_PWM_CHANNELS))
+    return -1;
+
+  pinGPIO = getGPIOPin(header, pin);
+  if ((pinGPIO == NULL) || gpioSetDirection(header, pin, GPIO_DIRECTION_OUTPUT))
+    return -1;
+
+  channels[channelCount] = pinGPIO;
+  duty[channelCount] = 0;
+  return channelCount++;
+}
+
+/**
+ * This function builds the event list for the current duty of all channels into the back
+ * list and hands it over to the scheduler. It has to be called with softPwmLock held.
+ */
+
+static void softPwmPublish(void)
+{
+  GPIOSoftPwmList_t *list = &lists[softPwmBack];
+  int order[MAX_SOFT_PWM_CHANNELS];
+  const GPIOBit_t *pinGPIO;
+  int i, j, n = 0;
+
+  memset(list, 0, sizeof(*list));
+
+  /* Insertion sort of the channels that go low inside the period */
+  for (i = 0; i < channelCount; i++) {
+    pinGPIO = channels[i];
+    if (duty[i] == 0) {
+      list->clear[pinGPIO->bank] |= pinGPIO->mask;
+      continue;
+    }
+    list->set[pinGPIO->bank] |= pinGPIO->mask;
+    if (duty[i] >= softPwmPeriod)
+      continue;
+
+    for (j = n; (j > 0) && (duty[order[j - 1]] > duty[i]); j--)
+      order[j] = order[j - 1];
+    order[j] = i;
+    n++;
+  }
+
+  /* Channels with the same duty share one event */
+  for (i = 0; i < n; i++) {
+    pinGPIO = channels[order[i]];
+    if ((list->count == 0) || (list->events[list->count - 1].offset != duty[order[i]]))
+      list->events[list->count++].offset = duty[order[i]];
+    list->events[list->count - 1].clear[pinGPIO->bank] |= pinGPIO->mask;
+  }
+
+  softPwmBack = __atomic_exchange_n(&softPwmMiddle, softPwmBack | SOFT_PWM_FRESH,
+    __ATOMIC_ACQ_REL) & ~SOFT_PWM_FRESH;
+}
+
+/**
+ * This function waits until the given CLOCK_MONOTONIC_RAW time. Long waits sleep
+ * with clock_nanosleep() until shortly before the deadline and then busy-wait.
+ * @param deadline a constant uint64_t argument, CLOCK_MONOTONIC_RAW time in nano seconds.
+ */
+
+static void waitUntil(const uint64_t deadline)
+{
+  struct timespec ts;
+  uint64_t now = gpioClockNs(CLOCK_MONOTONIC_RAW);
+
+  if (deadline > now + SPIN_THRESHOLD_NS) {
+    ts.tv_sec = (deadline - now - SPIN_THRESHOLD_NS) / 1000000000ULL;
+    ts.tv_nsec = (deadline - now - SPIN_THRESHOLD_NS) % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+  }
+
+  while (gpioClockNs(CLOCK_MONOTONIC_RAW) < deadline)
+    ;
+}
+
+/**
+ * This is the scheduler thread. At the start of each period it picks up a new event list if
+ * one was published, raises all channels with a non zero duty and then walks the events,
+ * doing one store per bank for each distinct duty.
+ * @param arg a void pointer argument, unused.
+ * @return NULL
+ */
+
+static void *softPwmSchedulerThread(void *arg)
+{
+  const GPIOSoftPwmList_t *list;
+  const GPIOSoftPwmEvent_t *ev;
+  uint64_t start;
+  int i, n;
+
+  gpioRealtimeThread(softPwmCpu);
+  start = gpioClockNs(CLOCK_MONOTONIC_RAW);
+
+  while (softPwmRunning) {
+    if (__atomic_load_n(&softPwmMiddle, __ATOMIC_ACQUIRE) & SOFT_PWM_FRESH)
+      softPwmFront = __atomic_exchange_n(&softPwmMiddle, softPwmFront,
+        __ATOMIC_ACQ_REL) & ~SOFT_PWM_FRESH;
+    list = &lists[softPwmFront];
+
+    waitUntil(start);
+    for (i = 0; i < GPIO_BANKS; i++) {
+      if (list->set[i])
+        mapGPIO[i][GPIO_SETDATAOUT_REG/4] = list->set[i];
+      if (list->clear[i])
+        mapGPIO[i][GPIO_CLEARDATAOUT_REG/4] = list->clear[i];
+    }
+
+    for (n = 0; n < list->count; n++) {
+      ev = &list->events[n];
+      waitUntil(start + ev->offset);
+      for (i = 0; i < GPIO_BANKS; i++)
+        if (ev->clear[i])
+          mapGPIO[i][GPIO_CLEARDATAOUT_REG/4] = ev->clear[i];
+    }
+
+    start += softPwmPeriod;
+  }
+
+  return NULL;
+}
+
+/**
+ * It starts the scheduler thread for the added channels. GPIO has to be opened with memory map access.
+ * @param period_ns a constant uint32_t argument, period shared by all channels in nano seconds.
+ * @param cpu a constant integer argument, CPU to pin the scheduler thread to or -1 for any.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int softPwmStart(const uint32_t period_ns, const int cpu)
+{
+  if (softPwmRunning || (channelCount == 0) || (period_ns == 0) || !gpioMmapReady())
+    return -1;
+
+  softPwmPeriod = period_ns;
+  softPwmCpu = cpu;
+  mlock(lists, sizeof(lists));
+
+  pthread_mutex_lock(&softPwmLock);
+  softPwmPublish();
+  pthread_mutex_unlock(&softPwmLock);
+
+  softPwmRunning = 1;
+  if (pthread_create(&softPwmThread, NULL, softPwmSchedulerThread, NULL) != 0) {
+    softPwmRunning = 0;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * It takes a channel number and duty and changes the duty of the channel.
+ * The change is applied at the start of the next period, so a period is never cut short.
+ * @param channel a constant integer argument.
+ * @param duty_ns a constant uint32_t argument, high time in nano seconds, a duty of a whole period or more keeps the pin high.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int softPwmSetDuty(const int channel, const uint32_t duty_ns)
+{
+  if ((channel < 0) || (channel >= channelCount))
+    return -1;
+
+  pthread_mutex_lock(&softPwmLock);
+  duty[channel] = duty_ns;
+  if (softPwmRunning)
+    softPwmPublish();
+  pthread_mutex_unlock(&softPwmLock);
+
+  return 0;
+}
+
+/**
+ * It takes a channel number and returns its duty.
+ * @param channel a constant integer argument.
+ * @return duty in nano seconds and -1 if it fails.
+ */
+
+int softPwmGetDuty(const int channel)
+{
+  if ((channel < 0) || (channel >= channelCount))
+    return -1;
+
+  return duty[channel];
+}
+
+/**
+ * For stopping the scheduler thread and removing all channels. All channel pins are driven low.
+ */
+
+void softPwmStop(void)
+{
+  int i;
+
+  if (softPwmRunning) {
+    softPwmRunning = 0;
+    pthread_join(softPwmThread, NULL);
+    munlock(lists, sizeof(lists));
+
+    for (i = 0; i < channelCount; i++)
+      mapGPIO[channels[i]->bank][GPIO_CLEARDATAOUT_REG/4] = channels[i]->mask;
+  }
+
+  channelCount = 0;
+}
@@ -0,0 +1,252 @@
+/**********************************************************
+  Software SPI master code bit-banged over mmap() access
+    of GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_softspi.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Software SPI master code bit-banged over mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_SOFT_SPI_BUSES 8	/**< Maximum number of software SPI buses open at once */
+
+/**
+ * typedef struct GPIOSoftSpiLine_t for storing the registers used to drive or sample one bus line.
+ */
+
+typedef struct {
+  volatile uint32_t *set;     /**< SET DATA OUT register of the line's bank */
+  volatile uint32_t *clear;   /**< CLEAR DATA OUT register of the line's bank */
+  volatile uint32_t *in;      /**< DATA IN register of the line's bank */
+  uint32_t mask;              /**< Bit of the line in its bank, 0 if the line is not used */
+} GPIOSoftSpiLine_t;
+
+/**
+ * typedef struct GPIOSoftSpi_t for storing the state of one software SPI bus.
+ */
+
+typedef struct {
+  int used;                               /**< Non zero if the bus is open */
+  GPIOSoftSpiLine_t line[4];              /**< SCLK, MOSI, MISO and CS lines */
+  uint8_t mode;                           /**< SPI mode 0 to 3 */
+  uint8_t lsbFirst;                       /**< Non zero to shift the least significant bit first */
+  uint32_t halfPeriod;                    /**< Half clock period in nano seconds, 0 for as fast as possible */
+  uint32_t achieved;                      /**< Clock rate achieved by the last transfer in Hz */
+} GPIOSoftSpi_t;
+
+static GPIOSoftSpi_t buses[MAX_SOFT_SPI_BUSES];	/**< Software SPI buses */
+
+/**
+ * This function drives a bus line high or low with a single store.
+ * @param line a constant GPIOSoftSpiLine_t pointer argument.
+ * @param value a constant integer argument.
+ */
+
+static inline void lineWrite(const GPIOSoftSpiLine_t *line, const int value)
+{
+  if (value)
+    *line->set = line->mask;
+  else
+    *line->clear = line->mask;
+}
+
+/**
+ * This function busy-waits until the given CLOCK_MONOTONIC_RAW time.
+ * @param deadline a constant uint64_t argument, time in nano seconds.
+ */
+
+static inline void spinUntil(const uint64_t deadline)
+{
+  while (gpioClockNs(CLOCK_MONOTONIC_RAW) < deadline)
+    ;
+}
+
+/**
+ * It takes the GPIO headers and pins of the SCLK, MOSI, MISO and CS lines and opens a
+ * software SPI bus on them. MISO and CS may be left out by passing header 0.
+ * GPIO has to be opened with memory map access. Every pin is checked before any direction
+ * changes, and if setting a direction still fails the lines already switched to outputs
+ * are turned back into inputs.
+ * @param headers a constant unsigned int array argument, indexed by SOFT_SPI_SCLK, SOFT_SPI_MOSI, SOFT_SPI_MISO and SOFT_SPI_CS.
+ * @param pins a constant unsigned int array argument, indexed like headers.
+ * @param mode a constant uint8_t argument, SPI mode 0 to 3.
+ * @param speed a constant uint32_t argument, target clock rate in Hz, 0 for as fast as possible.
+ * @param lsbFirst a constant uint8_t argument, non zero to shift the least significant bit first.
+ * @return bus id to pass to softSpiTransfer() on success and -1 if it fails.
+ */
+
+int softSpiOpen(const unsigned int headers[4], const unsigned int pins[4],
+  const uint8_t mode, const uint32_t speed, const uint8_t lsbFirst)
+{
+  const GPIOBit_t *pinGPIO;
+  GPIOSoftSpi_t *bus = NULL;
+  int i, id;
+
+  if ((mode > 3) || !gpioMmapReady())
+    return -1;
+
+  for (id = 0; id < MAX_SOFT_SPI_BUSES; id++) {
+    if (!buses[id].used) {
+      bus = &buses[id];
+      break;
+    }
+  }
+  if (bus == NULL)
+    return -1;
+
+  memset(bus, 0, sizeof(*bus));
+
+  for (i = 0; i < 4; i++) {
+    if ((headers[i] == 0) && ((i == SOFT_SPI_MISO) || (i == SOFT_SPI_CS)))
+      continue;
+
+    pinGPIO = getGPIOPin(headers[i], pins[i]);
+    if (pinGPIO == NULL)
+      return -1;
+
+    bus->line[i].set = &mapGPIO[pinGPIO->bank][GPIO_SETDATAOUT_REG/4];
+    bus->line[i].clear = &mapGPIO[pinGPIO->bank][GPIO_CLEARDATAOUT_REG/4];
+    bus->line[i].in = &mapGPIO[pinGPIO->bank][GPIO_DATA_IN_REG/4];
+    bus->line[i].mask = pinGPIO->mask;
+  }
+
+  bus->mode = mode;
+  bus->lsbFirst = lsbFirst;
+  bus->halfPeriod = speed ? 500000000 / speed : 0;
+
+  /* Idle levels go to DATA OUT before the outputs are enabled, so CS and SCLK never glitch */
+  lineWrite(&bus->line[SOFT_SPI_SCLK], mode & 2);
+  if (bus->line[SOFT_SPI_CS].mask)
+    lineWrite(&bus->line[SOFT_SPI_CS], 1);
+
+  for (i = 0; i < 4; i++) {
+    if (!bus->line[i].mask)
+      continue;
+
+    if (gpioSetDirection(headers[i], pins[i],
+        (i == SOFT_SPI_MISO) ? GPIO_DIRECTION_INPUT : GPIO_DIRECTION_OUTPUT)) {
+      /* Release the lines already driven instead of leaving a half open bus on them */
+      while (--i >= 0)
+        if (bus->line[i].mask && (i != SOFT_SPI_MISO))
+          gpioSetDirection(headers[i], pins[i], GPIO_DIRECTION_INPUT);
+      return -1;
+    }
+  }
+
+  bus->used = 1;
+  return id;
+}
+
+/**
+ * This function takes the id of a software SPI bus, tx buffer array to transmit data,
+ * rx buffer array to receive data and length of data to be transferred. It has the same
+ * signature as spiTransfer() so drivers can switch between hardware and software buses.
+ * CS is held low for the whole transfer.
+ * @param spiID a constant integer argument, id returned by softSpiOpen().
+ * @param tx a constant uint8_t array argument.
+ * @param rx a constant uint8_t array argument, filled with the received data unless NULL.
+ * @param len a constant integer argument.
+ * @return 0 if successful and -1 if it fails.
+ */
+
+int softSpiTransfer(const int spiID, const uint8_t tx[], const uint8_t rx[], const int len)
+{
+  GPIOSoftSpi_t *bus;
+  const GPIOSoftSpiLine_t *sclk, *mosi, *miso;
+  uint8_t *rxBuf = (uint8_t *) rx;
+  uint64_t start, deadline;
+  int cpol, cpha, i, bit;
+  uint8_t out, in, mask;
+
+  if ((spiID < 0) || (spiID >= MAX_SOFT_SPI_BUSES) || !buses[spiID].used || (len < 0))
+    return -1;
+
+  bus = &buses[spiID];
+  sclk = &bus->line[SOFT_SPI_SCLK];
+  mosi = &bus->line[SOFT_SPI_MOSI];
+  miso = &bus->line[SOFT_SPI_MISO];
+  cpol = (bus->mode & 2) != 0;
+  cpha = (bus->mode & 1) != 0;
+
+  if (bus->line[SOFT_SPI_CS].mask)
+    lineWrite(&bus->line[SOFT_SPI_CS], 0);
+
+  start = deadline = gpioClockNs(CLOCK_MONOTONIC_RAW);
+
+  for (i = 0; i < len; i++) {
+    out = tx ? tx[i] : 0;
+    in = 0;
+
+    for (bit = 0; bit < 8; bit++) {
+      mask = bus->lsbFirst ? (1 << bit) : (0x80 >> bit);
+
+      if (!cpha)
+        lineWrite(mosi, out & mask);
+
+      deadline += bus->halfPeriod;
+      spinUntil(deadline);
+      lineWrite(sclk, !cpol);	/* Leading edge */
+
+      if (cpha)
+        lineWrite(mosi, out & mask);
+      else if (miso->mask && (*miso->in & miso->mask))
+        in |= mask;
+
+      deadline += bus->halfPeriod;
+      spinUntil(deadline);
+      lineWrite(sclk, cpol);	/* Trailing edge */
+
+      if (cpha && miso->mask && (*miso->in & miso->mask))
+        in |= mask;
+    }
+
+    if (rxBuf)
+      rxBuf[i] = in;
+  }
+
+  deadline = gpioClockNs(CLOCK_MONOTONIC_RAW);
+
+  if (bus->line[SOFT_SPI_CS].mask)
+    lineWrite(&bus->line[SOFT_SPI_CS], 1);
+
+  if ((len > 0) && (deadline > start))
+    bus->achieved = (uint64_t) len * 8 * 1000000000ULL / (deadline - start);
+
+  return 0;
+}
+
+/**
+ * It takes the id of a software SPI bus and returns the clock rate the last transfer achieved.
+ * @param spiID a constant integer argument.
+ * @return clock rate in Hz, 0 if nothing was transferred yet and -1 for an invalid id.
+ */
+
+int softSpiGetSpeed(const int spiID)
+{
+  if ((spiID < 0) || (spiID >= MAX_SOFT_SPI_BUSES) || !buses[spiID].used)
+    return -1;
+
+  return buses[spiID].achieved;
+}
+
+/**
+ * For closing a software SPI bus.
+ * @param spiID a constant integer argument.
+ */
+
+void softSpiClose(const int spiID)
+{
+  if ((spiID >= 0) && (spiID < MAX_SOFT_SPI_BUSES))
+    buses[spiID].used = 0;
+}
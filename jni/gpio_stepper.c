@@ -0,0 +1,482 @@
+/**********************************************************
+  Stepper motor pulse generator code with acceleration
+    profiles over mmap() access of GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_stepper.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Stepper motor pulse generator code with acceleration profiles over mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_STEPPER_AXES    8			/**< Maximum number of axes driven at once */
+#define STEPPER_QUEUE_SIZE  64			/**< Size of the move queue, must be a power of two */
+#define STEPPER_IDLE_NS     1000000		/**< Sleep of the thread while the move queue is empty */
+#define STEPPER_SPIN_NS     50000		/**< Waits shorter than this are busy-waited, longer ones sleep first */
+#define STEPPER_FRAC_BITS   48			/**< Fraction bits of the fixed point step rate */
+#define STEPPER_ONE         (1ULL << STEPPER_FRAC_BITS)	/**< One step in fixed point */
+
+/**
+ * Stages of a move. Acceleration is split in segments that are replayed backwards
+ * while decelerating, so the deceleration mirrors the acceleration.
+ */
+
+#define SEG_RAMP_IN   0		/**< Acceleration rising with the jerk */
+#define SEG_HOLD      1		/**< Acceleration held at its maximum */
+#define SEG_RAMP_OUT  2		/**< Acceleration falling with the jerk */
+#define STAGE_ACCEL   0		/**< Speeding up */
+#define STAGE_CRUISE  1		/**< Running at the maximum rate */
+#define STAGE_DECEL   2		/**< Slowing down */
+
+/**
+ * typedef struct GPIOStepperAxis_t for storing the pins and position of one axis.
+ */
+
+typedef struct {
+  const GPIOBit_t *step;    /**< Pin information of the step pin */
+  const GPIOBit_t *dir;     /**< Pin information of the direction pin */
+  int64_t position;         /**< Position in steps, read atomically */
+} GPIOStepperAxis_t;
+
+/**
+ * typedef struct GPIOStepperMove_t for one queued move. Rates are steps per tick in fixed point.
+ */
+
+typedef struct {
+  int32_t steps[MAX_STEPPER_AXES];  /**< Relative steps of each axis */
+  uint64_t vmax;                    /**< Maximum rate of the leading axis */
+  int64_t amax;                     /**< Maximum acceleration per tick */
+  int64_t jerk;                     /**< Acceleration change per tick, 0 for a trapezoidal profile */
+  uint64_t rampOut;                 /**< Rate gained while the acceleration falls from amax to 0 */
+} GPIOStepperMove_t;
+
+/**
+ * typedef struct GPIOStepperState_t for the move being run by the step thread.
+ */
+
+typedef struct {
+  GPIOStepperMove_t move;               /**< Move being run */
+  uint32_t lead;                        /**< Steps of the axis moving furthest */
+  uint32_t done;                        /**< Steps of the leading axis done */
+  uint32_t accelSteps;                  /**< Steps of the leading axis done while accelerating */
+  uint32_t err[MAX_STEPPER_AXES];       /**< Bresenham error of each axis */
+  uint32_t segTicks[3];                 /**< Ticks spent in each acceleration segment */
+  int seg;                              /**< Current acceleration segment */
+  int stage;                            /**< Current stage of the move */
+  uint64_t v;                           /**< Rate of the leading axis */
+  uint64_t vFloor;                      /**< Rate of the first step, lowest rate while decelerating */
+  uint64_t phase;                       /**< Step phase of the leading axis */
+  int64_t a;                            /**< Acceleration */
+} GPIOStepperState_t;
+
+static GPIOStepperAxis_t axes[MAX_STEPPER_AXES];	/**< Driven axes */
+static int axisCount = 0;	/**< Number of driven axes */
+static GPIOStepperMove_t queue[STEPPER_QUEUE_SIZE];	/**< Queued moves */
+static unsigned int queueHead = 0;	/**< Next slot written by gpioStepperMove() */
+static unsigned int queueTail = 0;	/**< Next slot read by the step thread */
+static unsigned int movesDone = 0;	/**< Number of moves finished by the step thread */
+static uint32_t stepperTick = 5000;	/**< Tick of the step thread in nano seconds */
+static int stepperCpu = -1;	/**< CPU the step thread is pinned to, -1 for any */
+static volatile int stepperRunning = 0;	/**< Cleared to stop the step thread */
+static pthread_t stepperThread;	/**< Step thread */
+
+/**
+ * It takes the GPIO header and pin of the step and direction inputs of a driver and adds an axis.
+ * Axes have to be added before gpioStepperStart(). Both pins are made outputs.
+ * @param stepHeader a constant unsigned int argument.
+ * @param stepPin a constant unsigned int argument.
+ * @param dirHeader a constant unsigned int argument.
+ * @param dirPin a constant unsigned int argument.
+ * @return index of the axis on success and -1 if it fails.
+ */
+
+int gpioStepperAdd(const unsigned int stepHeader, const unsigned int stepPin,
+  const unsigned int dirHeader, const unsigned int dirPin)
+{
+  GPIOStepperAxis_t *axis;
+
+  if (stepperRunning || (axisCount >= MAX_STEPPER_AXES))
+    return -1;
+
+  axis = &axes[axisCount];
+  memset(axis, 0, sizeof(*axis));
+  axis->step = getGPIOPin(stepHeader, stepPin);
+  axis->dir = getGPIOPin(dirHeader, dirPin);
+  if ((axis->step == NULL) || (axis->dir == NULL))
+    return -1;
+
+  if (gpioSetDirection(stepHeader, stepPin, GPIO_DIRECTION_OUTPUT) ||
+      gpioSetDirection(dirHeader, dirPin, GPIO_DIRECTION_OUTPUT))
+    return -1;
+
+  return axisCount++;
+}
+
+/**
+ * This function loads a move into the step thread state and returns the direction pin stores.
+ * @param s a GPIOStepperState_t pointer argument.
+ * @param move a constant GPIOStepperMove_t pointer argument.
+ * @param set a uint32_t array argument that receives the direction bits to drive high.
+ * @param clear a uint32_t array argument that receives the direction bits to drive low.
+ */
+
+static void stepperLoad(GPIOStepperState_t *s, const GPIOStepperMove_t *move,
+  uint32_t set[GPIO_BANKS], uint32_t clear[GPIO_BANKS])
+{
+  uint32_t n;
+  int i;
+
+  memset(s, 0, sizeof(*s));
+  s->move = *move;
+
+  for (i = 0; i < axisCount; i++) {
+    n = (move->steps[i] < 0) ? -move->steps[i] : move->steps[i];
+    if (n > s->lead)
+      s->lead = n;
+    if (move->steps[i] < 0)
+      clear[axes[i].dir->bank] |= axes[i].dir->mask;
+    else
+      set[axes[i].dir->bank] |= axes[i].dir->mask;
+  }
+
+  for (i = 0; i < axisCount; i++)
+    s->err[i] = s->lead / 2;
+
+  s->stage = STAGE_ACCEL;
+  if (move->jerk) {
+    s->seg = SEG_RAMP_IN;
+  } else {
+    s->seg = SEG_HOLD;
+    s->a = move->amax;
+  }
+}
+
+/**
+ * This function advances the profile of the running move by one tick.
+ * It only uses additions, one multiplication and comparisons.
+ * @param s a GPIOStepperState_t pointer argument.
+ * @return non zero if the leading axis steps on this tick.
+ */
+
+static int stepperAdvance(GPIOStepperState_t *s)
+{
+  const GPIOStepperMove_t *m = &s->move;
+  uint64_t k;
+
+  if ((s->stage != STAGE_DECEL) && (s->lead - s->done <= s->accelSteps)) {
+    /* Time reversal of the acceleration: same segments backwards, acceleration negated */
+    s->stage = STAGE_DECEL;
+    s->a = -s->a;
+  }
+
+  if (s->stage == STAGE_ACCEL) {
+    if (m->jerk && (s->seg != SEG_RAMP_OUT)) {
+      k = s->segTicks[SEG_RAMP_IN];
+      if (s->v + ((s->seg == SEG_HOLD) ? m->rampOut : (k * k * m->jerk) >> 1) >= m->vmax)
+        s->seg = SEG_RAMP_OUT;
+    }
+
+    s->segTicks[s->seg]++;
+    if (s->seg == SEG_RAMP_IN) {
+      s->a += m->jerk;
+      if (s->a >= m->amax) {
+        s->a = m->amax;
+        s->seg = SEG_HOLD;
+      }
+    } else if (s->seg == SEG_RAMP_OUT) {
+      s->a -= m->jerk;
+      if (s->a <= 0) {
+        s->a = 0;
+        s->stage = STAGE_CRUISE;
+      }
+    }
+
+    s->v += s->a;
+    if (s->v >= m->vmax) {
+      s->v = m->vmax;
+      s->stage = STAGE_CRUISE;
+    }
+  } else if (s->stage == STAGE_DECEL) {
+    while ((s->seg >= 0) && (s->segTicks[s->seg] == 0))
+      s->seg--;
+    if (s->seg >= 0) {
+      s->segTicks[s->seg]--;
+      if (s->seg == SEG_RAMP_IN)
+        s->a += m->jerk;
+      else if (s->seg == SEG_RAMP_OUT)
+        s->a -= m->jerk;
+    }
+
+    if ((int64_t) s->v + s->a < (int64_t) s->vFloor)
+      s->v = s->vFloor;
+    else
+      s->v += s->a;
+  }
+
+  s->phase += s->v;
+  if (s->phase < STEPPER_ONE)
+    return 0;
+  s->phase -= STEPPER_ONE;
+
+  if (s->vFloor == 0)
+    s->vFloor = s->v;
+  if (s->stage == STAGE_ACCEL)
+    s->accelSteps++;
+
+  return 1;
+}
+
+/**
+ * This function waits until the tick of the given CLOCK_MONOTONIC time and drives the pins.
+ * Long waits sleep with clock_nanosleep() until shortly before the tick and then busy-wait.
+ * When the tick was missed by more than a tick the deadline is moved to now, so late
+ * ticks are not run back to back as pulses too short for a driver.
+ * Ticks without a store return at once, so the thread only waits for pin changes.
+ * @param set a constant uint32_t array argument, bits of each bank to drive high.
+ * @param clear a constant uint32_t array argument, bits of each bank to drive low.
+ * @param deadline a uint64_t pointer argument, time of the tick in nano seconds.
+ */
+
+static void stepperStore(const uint32_t set[GPIO_BANKS], const uint32_t clear[GPIO_BANKS],
+  uint64_t *deadline)
+{
+  struct timespec ts;
+  uint64_t now;
+  int i;
+
+  for (i = 0; i < GPIO_BANKS; i++)
+    if (set[i] || clear[i])
+      break;
+  if (i == GPIO_BANKS)
+    return;
+
+  now = gpioClockNs(CLOCK_MONOTONIC);
+  if (*deadline > now + STEPPER_SPIN_NS) {
+    ts.tv_sec = (*deadline - STEPPER_SPIN_NS) / 1000000000ULL;
+    ts.tv_nsec = (*deadline - STEPPER_SPIN_NS) % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+  }
+
+  while ((now = gpioClockNs(CLOCK_MONOTONIC)) < *deadline)
+    ;
+  if (now - *deadline > stepperTick)
+    *deadline = now;
+
+  for (i = 0; i < GPIO_BANKS; i++) {
+    if (set[i])
+      mapGPIO[i][GPIO_SETDATAOUT_REG/4] = set[i];
+    if (clear[i])
+      mapGPIO[i][GPIO_CLEARDATAOUT_REG/4] = clear[i];
+  }
+}
+
+/**
+ * This is the step thread. It runs on a fixed tick: every tick releases the step pins raised
+ * on the previous tick, advances the profile of the running move and raises the step pins of
+ * the axes that step, with one store per bank. Ticks that change no pin are computed without
+ * waiting, and the waits between pin changes sleep, so slow moves leave the CPU to others.
+ * @param arg a void pointer argument, unused.
+ * @return NULL
+ */
+
+static void *stepperStepThread(void *arg)
+{
+  uint32_t set[GPIO_BANKS], clear[GPIO_BANKS], pulse[GPIO_BANKS] = { 0, 0, 0, 0 };
+  struct timespec idle = { 0, STEPPER_IDLE_NS };
+  GPIOStepperState_t s;
+  uint64_t deadline;
+  uint32_t n, stepped = 0;
+  int active = 0, i;
+
+  gpioRealtimeThread(stepperCpu);
+  deadline = gpioClockNs(CLOCK_MONOTONIC);
+
+  while (stepperRunning) {
+    deadline += stepperTick;
+
+    memset(set, 0, sizeof(set));
+    memcpy(clear, pulse, sizeof(clear));
+    memset(pulse, 0, sizeof(pulse));
+
+    if (!active) {
+      if (queueTail == __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE)) {
+        stepperStore(set, clear, &deadline);
+        nanosleep(&idle, NULL);
+        deadline = gpioClockNs(CLOCK_MONOTONIC);
+        continue;
+      }
+
+      /* Direction pins change here, the first step comes a tick later */
+      stepperLoad(&s, &queue[queueTail & (STEPPER_QUEUE_SIZE - 1)], set, clear);
+      __atomic_store_n(&queueTail, queueTail + 1, __ATOMIC_RELEASE);
+      active = 1;
+    } else if (stepperAdvance(&s)) {
+      for (i = 0; i < axisCount; i++) {
+        n = (s.move.steps[i] < 0) ? -s.move.steps[i] : s.move.steps[i];
+        s.err[i] += n;
+        if (s.err[i] < s.lead)
+          continue;
+        s.err[i] -= s.lead;
+
+        pulse[axes[i].step->bank] |= axes[i].step->mask;
+        stepped |= 1u << i;
+      }
+      s.done++;
+    }
+
+    for (i = 0; i < GPIO_BANKS; i++) {
+      set[i] |= pulse[i];
+      clear[i] &= ~set[i];
+    }
+    stepperStore(set, clear, &deadline);
+
+    /* Positions and finished moves are published once the pulses are out */
+    for (i = 0; stepped; i++, stepped >>= 1)
+      if (stepped & 1)
+        __atomic_store_n(&axes[i].position,
+          axes[i].position + ((s.move.steps[i] < 0) ? -1 : 1), __ATOMIC_RELAXED);
+
+    if (active && (s.done >= s.lead)) {
+      active = 0;
+      __atomic_store_n(&movesDone, movesDone + 1, __ATOMIC_RELEASE);
+    }
+  }
+
+  for (i = 0; i < GPIO_BANKS; i++)
+    if (pulse[i])
+      mapGPIO[i][GPIO_CLEARDATAOUT_REG/4] = pulse[i];
+
+  return NULL;
+}
+
+/**
+ * It starts the step thread for the added axes. GPIO has to be opened with memory map access.
+ * Step pulses are one tick wide, so the highest step rate is half the tick rate.
+ * @param cpu a constant integer argument, CPU to pin the step thread to or -1 for any.
+ * @param tick_ns a constant uint32_t argument, tick of the step thread in nano seconds.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int gpioStepperStart(const int cpu, const uint32_t tick_ns)
+{
+  if (stepperRunning || (axisCount == 0) || (tick_ns == 0) || !gpioMmapReady())
+    return -1;
+
+  stepperCpu = cpu;
+  stepperTick = tick_ns;
+  queueHead = queueTail = movesDone = 0;
+  stepperRunning = 1;
+
+  if (pthread_create(&stepperThread, NULL, stepperStepThread, NULL) != 0) {
+    stepperRunning = 0;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * It appends a coordinated move of all axes to the move queue. The axis moving furthest
+ * follows the profile and the other axes are interpolated so that all of them arrive together.
+ * Moves can be appended once gpioStepperStart() was called, also while earlier moves run.
+ * Each move starts and ends at rest.
+ * The profile is converted to fixed point here once, so the step thread never divides.
+ * @param steps a constant int32_t array argument, relative steps of each axis in the order they were added.
+ * @param rate a constant double argument, maximum step rate of the leading axis in steps per second.
+ * @param accel a constant double argument, acceleration in steps per second squared.
+ * @param jerk a constant double argument, jerk in steps per second cubed for an S-curve profile, 0 for a trapezoidal profile.
+ * @return 0 on success and -1 if the queue is full or the parameters are invalid.
+ */
+
+int gpioStepperMove(const int32_t steps[], const double rate, const double accel, const double jerk)
+{
+  GPIOStepperMove_t *move;
+  unsigned int head = queueHead;
+  double tick = stepperTick * 1e-9;
+  double vmax, amax, j;
+  int i;
+
+  if (!stepperRunning || (rate <= 0) || (accel <= 0) || (jerk < 0))
+    return -1;
+
+  if (head - __atomic_load_n(&queueTail, __ATOMIC_ACQUIRE) >= STEPPER_QUEUE_SIZE)
+    return -1;
+
+  vmax = rate * tick * STEPPER_ONE;
+  amax = accel * tick * tick * STEPPER_ONE;
+  j = jerk * tick * tick * tick * STEPPER_ONE;
+
+  /* Pulses are one tick high and one tick low at least */
+  if (vmax > STEPPER_ONE / 2)
+    vmax = STEPPER_ONE / 2;
+  if (amax > vmax)
+    amax = vmax;
+
+  move = &queue[head & (STEPPER_QUEUE_SIZE - 1)];
+  memset(move, 0, sizeof(*move));
+  for (i = 0; i < axisCount; i++)
+    move->steps[i] = steps[i];
+  move->vmax = vmax;
+  move->amax = (amax < 1) ? 1 : amax;
+  if (jerk > 0) {
+    /* Ramps longer than 2^20 ticks would overflow the ramp out estimate */
+    if (j < amax / (1 << 20))
+      j = amax / (1 << 20);
+    move->jerk = (j < 1) ? 1 : j;
+    move->rampOut = amax * amax / (2 * move->jerk);
+  }
+
+  __atomic_store_n(&queueHead, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * It returns the number of moves queued or running.
+ * @return number of moves not finished yet.
+ */
+
+int gpioStepperPending(void)
+{
+  return __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE) -
+    __atomic_load_n(&movesDone, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * It takes an axis index and returns the position of the axis without blocking the step thread.
+ * @param index a constant integer argument.
+ * @return position in steps, 0 for an invalid index.
+ */
+
+int64_t gpioStepperPosition(const int index)
+{
+  if ((index < 0) || (index >= axisCount))
+    return 0;
+
+  return __atomic_load_n(&axes[index].position, __ATOMIC_RELAXED);
+}
+
+/**
+ * For stopping the step thread and removing all axes. Queued moves are dropped.
+ */
+
+void gpioStepperStop(void)
+{
+  if (stepperRunning) {
+    stepperRunning = 0;
+    pthread_join(stepperThread, NULL);
+  }
+
+  axisCount = 0;
+}
@@ -0,0 +1,214 @@
+/**********************************************************
+  GPIO waveform playback code for mmap() access
+    of GPIO banks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file gpio_waveform.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief GPIO waveform playback code for mmap() access of GPIO banks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define SPIN_THRESHOLD_NS 50000	/**< Delays shorter than this are busy-waited, longer ones sleep first */
+
+/**
+ * struct GPIOWaveform for storing a waveform and the timing of its last playback.
+ */
+
+struct GPIOWaveform {
+  GPIOWaveStep_t *steps;   /**< Locked copy of the steps */
+  int32_t *jitter;         /**< Lateness of each step in the last playback in nano seconds */
+  uint32_t count;          /**< Number of steps */
+  uint32_t budget;         /**< Allowed lateness of a step in nano seconds */
+  uint32_t late;           /**< Steps of the last playback that were later than the budget */
+  int cpu;                 /**< CPU the playback thread is pinned to, -1 for any */
+};
+
+/**
+ * It takes an array of waveform steps and creates a waveform from them.
+ * The steps are copied into a buffer that is locked and touched here so that
+ * playback never page faults.
+ * @param steps a constant GPIOWaveStep_t array argument.
+ * @param count a constant uint32_t argument.
+ * @return pointer to the waveform on success and NULL if it fails.
+ */
+
+GPIOWaveform_t *gpioWaveformCreate(const GPIOWaveStep_t steps[], const uint32_t count)
+{
+  GPIOWaveform_t *wave;
+
+  if (count == 0)
+    return NULL;
+
+  wave = (GPIOWaveform_t *) calloc(1, sizeof(GPIOWaveform_t));
+  if (wave == NULL)
+    return NULL;
+
+  wave->steps = (GPIOWaveStep_t *) malloc(sizeof(GPIOWaveStep_t) * count);
+  wave->jitter = (int32_t *) malloc(sizeof(int32_t) * count);
+  if ((wave->steps == NULL) || (wave->jitter == NULL)) {
+    free(wave->steps);
+    free(wave->jitter);
+    free(wave);
+    return NULL;
+  }
+
+  memcpy(wave->steps, steps, sizeof(GPIOWaveStep_t) * count);
+  memset(wave->jitter, 0, sizeof(int32_t) * count);
+  mlock(wave->steps, sizeof(GPIOWaveStep_t) * count);
+  mlock(wave->jitter, sizeof(int32_t) * count);
+  wave->count = count;
+
+  return wave;
+}
+
+/**
+ * This function waits until the given CLOCK_MONOTONIC_RAW time. Long waits sleep
+ * with clock_nanosleep() until shortly before the deadline and then busy-wait.
+ * @param deadline a constant uint64_t argument, CLOCK_MONOTONIC_RAW time in nano seconds.
+ * @return time at which the wait ended.
+ */
+
+static uint64_t waitUntil(const uint64_t deadline)
+{
+  struct timespec ts;
+  uint64_t now = gpioClockNs(CLOCK_MONOTONIC_RAW);
+
+  if (deadline > now + SPIN_THRESHOLD_NS) {
+    ts.tv_sec = (deadline - now - SPIN_THRESHOLD_NS) / 1000000000ULL;
+    ts.tv_nsec = (deadline - now - SPIN_THRESHOLD_NS) % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+  }
+
+  while ((now = gpioClockNs(CLOCK_MONOTONIC_RAW)) < deadline)
+    ;
+
+  return now;
+}
+
+/**
+ * This is the playback thread. Steps are scheduled on absolute times so that
+ * lateness of one step does not shift the following ones.
+ * @param arg a void pointer argument, the waveform.
+ * @return NULL
+ */
+
+static void *waveformThread(void *arg)
+{
+  GPIOWaveform_t *wave = (GPIOWaveform_t *) arg;
+  const GPIOWaveStep_t *step;
+  uint64_t deadline, now;
+  uint32_t n;
+  int i;
+
+  gpioRealtimeThread(wave->cpu);
+
+  wave->late = 0;
+  deadline = gpioClockNs(CLOCK_MONOTONIC_RAW);
+
+  for (n = 0; n < wave->count; n++) {
+    step = &wave->steps[n];
+    now = waitUntil(deadline);
+
+    for (i = 0; i < GPIO_BANKS; i++) {
+      if (step->set[i])
+        mapGPIO[i][GPIO_SETDATAOUT_REG/4] = step->set[i];
+      if (step->clear[i])
+        mapGPIO[i][GPIO_CLEARDATAOUT_REG/4] = step->clear[i];
+    }
+
+    wave->jitter[n] = (int32_t) (now - deadline);
+    if ((uint32_t) wave->jitter[n] > wave->budget)
+      wave->late++;
+
+    deadline += step->delay_ns;
+  }
+
+  return NULL;
+}
+
+/**
+ * It plays a waveform once on a real-time thread and returns when it is done.
+ * Each step drives its set and clear masks with one store per bank and then waits
+ * for its delay. GPIO has to be opened with memory map access.
+ * @param wave a GPIOWaveform_t pointer argument.
+ * @param budget_ns a constant uint32_t argument, allowed lateness of each step in nano seconds.
+ * @param cpu a constant integer argument, CPU to pin the playback thread to or -1 for any.
+ * @see gpioWaveformJitter()
+ * @return number of steps later than the budget on success and -1 if it fails.
+ */
+
+int gpioWaveformPlay(GPIOWaveform_t *wave, const uint32_t budget_ns, const int cpu)
+{
+  pthread_t thread;
+
+  if ((wave == NULL) || !gpioMmapReady())
+    return -1;
+
+  wave->budget = budget_ns;
+  wave->cpu = cpu;
+
+  if (pthread_create(&thread, NULL, waveformThread, wave) != 0)
+    return -1;
+  if (pthread_join(thread, NULL) != 0)
+    return -1;
+
+  return wave->late;
+}
+
+/**
+ * It copies the lateness of each step of the last playback, and returns the worst lateness.
+ * @param wave a constant GPIOWaveform_t pointer argument.
+ * @param jitter an int32_t array argument that receives up to max values in nano seconds, may be NULL.
+ * @param max a constant uint32_t argument.
+ * @return the largest lateness of the last playback in nano seconds.
+ */
+
+int32_t gpioWaveformJitter(const GPIOWaveform_t *wave, int32_t jitter[], const uint32_t max)
+{
+  int32_t worst = 0;
+  uint32_t n;
+
+  if (wave == NULL)
+    return 0;
+
+  for (n = 0; n < wave->count; n++) {
+    if ((jitter != NULL) && (n < max))
+      jitter[n] = wave->jitter[n];
+    if (wave->jitter[n] > worst)
+      worst = wave->jitter[n];
+  }
+
+  return worst;
+}
+
+/**
+ * For freeing a waveform created by gpioWaveformCreate().
+ * @param wave a GPIOWaveform_t pointer argument.
+ */
+
+void gpioWaveformFree(GPIOWaveform_t *wave)
+{
+  if (wave == NULL)
+    return;
+
+  munlock(wave->steps, sizeof(GPIOWaveStep_t) * wave->count);
+  munlock(wave->jitter, sizeof(int32_t) * wave->count);
+  free(wave->steps);
+  free(wave->jitter);
+  free(wave);
+}
@@ -61,6 +61,263 @@ void JAVA_CLASS_PATH(writeGPIO)(JNIEnv *env, jobject this, jint header, jint pin
 }
 /* End the JNI wrapper functions for the GPIO app */
 
+/* Begin the JNI wrapper functions for GPIO edge events */
+jboolean JAVA_CLASS_PATH(gpioSetEdge)(JNIEnv *env, jobject this, jint header, jint pin, jint edge)
+{
+	if ( gpioSetEdge((unsigned int) header, (unsigned int) pin, edge) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioSetEdge(%d, %d, %d) failed!", (unsigned int) header, (unsigned int) pin, edge);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioSetEdge(%d, %d, %d) succeeded", (unsigned int) header, (unsigned int) pin, edge);
+	return JNI_TRUE;
+}
+
+jboolean JAVA_CLASS_PATH(gpioEventAdd)(JNIEnv *env, jobject this, jint header, jint pin)
+{
+	if ( gpioEventAdd((unsigned int) header, (unsigned int) pin) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioEventAdd(%d, %d) failed!", (unsigned int) header, (unsigned int) pin);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioEventAdd(%d, %d) succeeded", (unsigned int) header, (unsigned int) pin);
+	return JNI_TRUE;
+}
+
+jboolean JAVA_CLASS_PATH(gpioEventRemove)(JNIEnv *env, jobject this, jint header, jint pin)
+{
+	if ( gpioEventRemove((unsigned int) header, (unsigned int) pin) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioEventRemove(%d, %d) failed!", (unsigned int) header, (unsigned int) pin);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioEventRemove(%d, %d) succeeded", (unsigned int) header, (unsigned int) pin);
+	return JNI_TRUE;
+}
+
+jint JAVA_CLASS_PATH(gpioEventWait)(JNIEnv *env, jobject this, jint timeout_ms)
+{
+	jint ret = gpioEventWait(timeout_ms);
+
+	if ( ret == -1 )
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioEventWait(%d) failed!", timeout_ms);
+
+	return ret;
+}
+
+jint JAVA_CLASS_PATH(gpioEventRead)(JNIEnv *env, jobject this, jintArray headers, jintArray pins, jintArray values, jlongArray timestamps)
+{
+	GPIOEvent_t events[BUFFER_SIZE];
+	jint header[BUFFER_SIZE], pin[BUFFER_SIZE], value[BUFFER_SIZE];
+	jlong timestamp[BUFFER_SIZE];
+	int i, count = (*env)->GetArrayLength(env, headers);
+
+	if (count > BUFFER_SIZE)
+		count = BUFFER_SIZE;
+
+	count = gpioEventRead(events, count);
+
+	for (i = 0; i < count; i++) {
+		header[i] = events[i].header;
+		pin[i] = events[i].pin;
+		value[i] = events[i].value;
+		timestamp[i] = events[i].timestamp;
+	}
+
+	(*env)->SetIntArrayRegion(env, headers, 0, count, header);
+	(*env)->SetIntArrayRegion(env, pins, 0, count, pin);
+	(*env)->SetIntArrayRegion(env, values, 0, count, value);
+	(*env)->SetLongArrayRegion(env, timestamps, 0, count, timestamp);
+
+	return count;
+}
+
+jboolean JAVA_CLASS_PATH(gpioEventFilter)(JNIEnv *env, jobject this, jint header, jint pin, jint stable_us, jint glitch_us)
+{
+	if ( gpioEventFilter((unsigned int) header, (unsigned int) pin, (uint32_t) stable_us, (uint32_t) glitch_us) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioEventFilter(%d, %d, %d, %d) failed!", (unsigned int) header, (unsigned int) pin, stable_us, glitch_us);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioEventFilter(%d, %d, %d, %d) succeeded", (unsigned int) header, (unsigned int) pin, stable_us, glitch_us);
+	return JNI_TRUE;
+}
+
+jint JAVA_CLASS_PATH(gpioEventSuppressed)(JNIEnv *env, jobject this, jint header, jint pin)
+{
+	return gpioEventSuppressed((unsigned int) header, (unsigned int) pin);
+}
+
+void JAVA_CLASS_PATH(gpioEventClose)(JNIEnv *env, jobject this)
+{
+	gpioEventClose();
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioEventClose() succeeded");
+}
+/* End the JNI wrapper functions for GPIO edge events */
+
+/* Begin the JNI wrapper functions for GPIO edge counting */
+jboolean JAVA_CLASS_PATH(gpioCounterAdd)(JNIEnv *env, jobject this, jint header, jint pin)
+{
+	if ( gpioCounterAdd((unsigned int) header, (unsigned int) pin) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioCounterAdd(%d, %d) failed!", (unsigned int) header, (unsigned int) pin);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioCounterAdd(%d, %d) succeeded", (unsigned int) header, (unsigned int) pin);
+	return JNI_TRUE;
+}
+
+jboolean JAVA_CLASS_PATH(gpioCounterStart)(JNIEnv *env, jobject this, jint cpu, jint poll_us)
+{
+	if ( gpioCounterStart(cpu, (uint32_t) poll_us) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioCounterStart(%d, %d) failed!", cpu, poll_us);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioCounterStart(%d, %d) succeeded", cpu, poll_us);
+	return JNI_TRUE;
+}
+
+jlong JAVA_CLASS_PATH(gpioCounterEdges)(JNIEnv *env, jobject this, jint header, jint pin)
+{
+	GPIOCount_t count;
+
+	if ( gpioCounterRead((unsigned int) header, (unsigned int) pin, &count) == -1 )
+		return -1;
+
+	return count.edges;
+}
+
+jdouble JAVA_CLASS_PATH(gpioCounterFrequency)(JNIEnv *env, jobject this, jint header, jint pin)
+{
+	return gpioCounterFrequency((unsigned int) header, (unsigned int) pin);
+}
+
+jdouble JAVA_CLASS_PATH(gpioCounterDuty)(JNIEnv *env, jobject this, jint header, jint pin)
+{
+	return gpioCounterDuty((unsigned int) header, (unsigned int) pin);
+}
+
+void JAVA_CLASS_PATH(gpioCounterStop)(JNIEnv *env, jobject this)
+{
+	gpioCounterStop();
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioCounterStop() succeeded");
+}
+/* End the JNI wrapper functions for GPIO edge counting */
+
+/* Begin the JNI wrapper functions for quadrature encoders */
+jint JAVA_CLASS_PATH(gpioEncoderAdd)(JNIEnv *env, jobject this, jint headerA, jint pinA, jint headerB, jint pinB)
+{
+	jint ret = gpioEncoderAdd((unsigned int) headerA, (unsigned int) pinA, (unsigned int) headerB, (unsigned int) pinB);
+
+	if ( ret == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioEncoderAdd(%d, %d, %d, %d) failed!", headerA, pinA, headerB, pinB);
+	} else {
+		__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioEncoderAdd(%d, %d, %d, %d) succeeded", headerA, pinA, headerB, pinB);
+	}
+
+	return ret;
+}
+
+jboolean JAVA_CLASS_PATH(gpioEncoderStart)(JNIEnv *env, jobject this, jint cpu, jint sample_us, jint window_us)
+{
+	if ( gpioEncoderStart(cpu, (uint32_t) sample_us, (uint32_t) window_us) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioEncoderStart(%d, %d, %d) failed!", cpu, sample_us, window_us);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioEncoderStart(%d, %d, %d) succeeded", cpu, sample_us, window_us);
+	return JNI_TRUE;
+}
+
+jlong JAVA_CLASS_PATH(gpioEncoderPosition)(JNIEnv *env, jobject this, jint index)
+{
+	return gpioEncoderPosition(index);
+}
+
+jdouble JAVA_CLASS_PATH(gpioEncoderVelocity)(JNIEnv *env, jobject this, jint index)
+{
+	return gpioEncoderVelocity(index);
+}
+
+void JAVA_CLASS_PATH(gpioEncoderStop)(JNIEnv *env, jobject this)
+{
+	gpioEncoderStop();
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioEncoderStop() succeeded");
+}
+/* End the JNI wrapper functions for quadrature encoders */
+
+/* Begin the JNI wrapper functions for matrix keypads */
+jboolean JAVA_CLASS_PATH(gpioKeypadStart)(JNIEnv *env, jobject this, jintArray rowHeaders, jintArray rowPins, jintArray colHeaders, jintArray colPins, jint scan_us, jint debounce)
+{
+	jint rh[BUFFER_SIZE], rp[BUFFER_SIZE], ch[BUFFER_SIZE], cp[BUFFER_SIZE];
+	unsigned int rowH[BUFFER_SIZE], rowP[BUFFER_SIZE], colH[BUFFER_SIZE], colP[BUFFER_SIZE];
+	int i, rows = (*env)->GetArrayLength(env, rowHeaders), cols = (*env)->GetArrayLength(env, colHeaders);
+
+	if ((rows > BUFFER_SIZE) || (cols > BUFFER_SIZE))
+		return JNI_FALSE;
+
+	(*env)->GetIntArrayRegion(env, rowHeaders, 0, rows, rh);
+	(*env)->GetIntArrayRegion(env, rowPins, 0, rows, rp);
+	(*env)->GetIntArrayRegion(env, colHeaders, 0, cols, ch);
+	(*env)->GetIntArrayRegion(env, colPins, 0, cols, cp);
+
+	for (i = 0; i < rows; i++) {
+		rowH[i] = rh[i];
+		rowP[i] = rp[i];
+	}
+	for (i = 0; i < cols; i++) {
+		colH[i] = ch[i];
+		colP[i] = cp[i];
+	}
+
+	if ( gpioKeypadStart(rowH, rowP, rows, colH, colP, cols, (uint32_t) scan_us, debounce) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "gpioKeypadStart(%d x %d, %d, %d) failed!", rows, cols, scan_us, debounce);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioKeypadStart(%d x %d, %d, %d) succeeded", rows, cols, scan_us, debounce);
+	return JNI_TRUE;
+}
+
+jint JAVA_CLASS_PATH(gpioKeypadRead)(JNIEnv *env, jobject this, jintArray rows, jintArray cols, jintArray downs, jlongArray timestamps)
+{
+	GPIOKeyEvent_t events[BUFFER_SIZE];
+	jint row[BUFFER_SIZE], col[BUFFER_SIZE], down[BUFFER_SIZE];
+	jlong timestamp[BUFFER_SIZE];
+	int i, count = (*env)->GetArrayLength(env, rows);
+
+	if (count > BUFFER_SIZE)
+		count = BUFFER_SIZE;
+
+	count = gpioKeypadRead(events, count);
+
+	for (i = 0; i < count; i++) {
+		row[i] = events[i].row;
+		col[i] = events[i].col;
+		down[i] = events[i].down;
+		timestamp[i] = events[i].timestamp;
+	}
+
+	(*env)->SetIntArrayRegion(env, rows, 0, count, row);
+	(*env)->SetIntArrayRegion(env, cols, 0, count, col);
+	(*env)->SetIntArrayRegion(env, downs, 0, count, down);
+	(*env)->SetLongArrayRegion(env, timestamps, 0, count, timestamp);
+
+	return count;
+}
+
+void JAVA_CLASS_PATH(gpioKeypadStop)(JNIEnv *env, jobject this)
+{
+	gpioKeypadStop();
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "gpioKeypadStop() succeeded");
+}
+/* End the JNI wrapper functions for matrix keypads */
+
 /* Begin the JNI wrapper functions for the PWM app */
 jboolean JAVA_CLASS_PATH(pwmSetPeriod)(JNIEnv *env, jobject this, jint channel, jint period_ns)
 {
@@ -197,8 +454,124 @@ jint JAVA_CLASS_PATH(pwmRunCheck)(JNIEnv *env, jobject this, jint channel)
 	return ret;
 }
 
+jboolean JAVA_CLASS_PATH(pwmConfigure)(JNIEnv *env, jobject this, jint channel, jint period_ns, jint duty_ns, jint polarity, jboolean run)
+{
+	jint ret;
+	ret = pwmConfigure(channel, period_ns, duty_ns, polarity, run) ;
+
+	if ( ret == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "pwmConfigure(%d, %d, %d, %d, %d) failed!", (unsigned int) channel, (unsigned int) period_ns, (unsigned int) duty_ns, (unsigned int) polarity, (unsigned int) run);
+		return JNI_FALSE;
+	}
+
+	return JNI_TRUE;
+}
+
 /* End the JNI wrapper functions for the PWM app */
 
+/* Begin the JNI wrapper functions for PWM duty streaming */
+jboolean JAVA_CLASS_PATH(pwmStreamStart)(JNIEnv *env, jobject this, jint channel, jint rate_hz, jint cpu)
+{
+	if ( pwmStreamStart(channel, rate_hz, cpu) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "pwmStreamStart(%d, %d, %d) failed!", (unsigned int) channel, (unsigned int) rate_hz, cpu);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "pwmStreamStart(%d, %d, %d) succeeded", (unsigned int) channel, (unsigned int) rate_hz, cpu);
+	return JNI_TRUE;
+}
+
+jint JAVA_CLASS_PATH(pwmStreamQueue)(JNIEnv *env, jobject this, jintArray duty_ns)
+{
+	int count = (*env)->GetArrayLength(env, duty_ns);
+	jint* dutyPtr = (*env)->GetIntArrayElements(env, duty_ns, NULL);
+	jint ret;
+
+	ret = pwmStreamQueue((const uint32_t *) dutyPtr, count);
+	(*env)->ReleaseIntArrayElements(env, duty_ns, dutyPtr, 0);
+
+	if ( ret == -1 )
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "pwmStreamQueue(%d) failed!", count);
+
+	return ret;
+}
+
+jint JAVA_CLASS_PATH(pwmStreamUnderruns)(JNIEnv *env, jobject this)
+{
+	return pwmStreamUnderruns();
+}
+
+jint JAVA_CLASS_PATH(pwmStreamLate)(JNIEnv *env, jobject this)
+{
+	return pwmStreamLate();
+}
+
+jint JAVA_CLASS_PATH(pwmStreamErrors)(JNIEnv *env, jobject this)
+{
+	return pwmStreamErrors();
+}
+
+void JAVA_CLASS_PATH(pwmStreamStop)(JNIEnv *env, jobject this)
+{
+	pwmStreamStop();
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "pwmStreamStop() succeeded");
+}
+/* End the JNI wrapper functions for PWM duty streaming */
+
+/* Begin the JNI wrapper functions for servos */
+jint JAVA_CLASS_PATH(pwmServoAdd)(JNIEnv *env, jobject this, jint channel, jint period_ns, jint minPulse_ns, jint maxPulse_ns, jint minDeg, jint maxDeg)
+{
+	jint ret;
+	ret = pwmServoAdd(channel, period_ns, minPulse_ns, maxPulse_ns, minDeg, maxDeg) ;
+
+	if ( ret == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "pwmServoAdd(%d, %d, %d, %d, %d, %d) failed!", (unsigned int) channel, (unsigned int) period_ns, (unsigned int) minPulse_ns, (unsigned int) maxPulse_ns, minDeg, maxDeg);
+	} else {
+		__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "pwmServoAdd(%d, %d, %d, %d, %d, %d) succeeded", (unsigned int) channel, (unsigned int) period_ns, (unsigned int) minPulse_ns, (unsigned int) maxPulse_ns, minDeg, maxDeg);
+	}
+
+	return ret;
+}
+
+jboolean JAVA_CLASS_PATH(pwmServoStart)(JNIEnv *env, jobject this, jint tick_us, jint cpu)
+{
+	if ( pwmServoStart(tick_us, cpu) == -1 ) {
+		__android_log_print(ANDROID_LOG_ERROR, BBBANDROID_NATIVE_TAG, "pwmServoStart(%d, %d) failed!", (unsigned int) tick_us, cpu);
+		return JNI_FALSE;
+	}
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "pwmServoStart(%d, %d) succeeded", (unsigned int) tick_us, cpu);
+	return JNI_TRUE;
+}
+
+/* Called at control loop rates, so it does not log */
+jboolean JAVA_CLASS_PATH(pwmServoSetTarget)(JNIEnv *env, jobject this, jint servo, jint angle)
+{
+	return (pwmServoSetTarget(servo, angle) == 0) ? JNI_TRUE : JNI_FALSE;
+}
+
+jboolean JAVA_CLASS_PATH(pwmServoSetSlew)(JNIEnv *env, jobject this, jint servo, jint rate)
+{
+	return (pwmServoSetSlew(servo, rate) == 0) ? JNI_TRUE : JNI_FALSE;
+}
+
+jint JAVA_CLASS_PATH(pwmServoPosition)(JNIEnv *env, jobject this, jint servo)
+{
+	int32_t angle = 0;
+
+	pwmServoPosition(servo, &angle);
+	return angle;
+}
+
+void JAVA_CLASS_PATH(pwmServoStop)(JNIEnv *env, jobject this)
+{
+	pwmServoStop();
+
+	__android_log_print(ANDROID_LOG_DEBUG, BBBANDROID_NATIVE_TAG, "pwmServoStop() succeeded");
+}
+/* End the JNI wrapper functions for servos */
+
 /* Begin the JNI wrapper functions for the ADC app */
 
 jint JAVA_CLASS_PATH(readADC)(JNIEnv *env, jobject this, jint channel)
@@ -1,5 +1,6 @@
 /**********************************************************
   PWM general purpose interface code for file system
+    and mmap() access of EHRPWM registers
 
   Written by Ankur Yadav (ankurayadav@gmail.com)
 
@@ -9,15 +10,197 @@
 /**
  * @file pwm.c
  * @author Ankur Yadav (ankurayadav@gmail.com)
- * @brief PWM general purpose interface code for file system
+ * @brief PWM general purpose interface code for file system and mmap() access of EHRPWM registers
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include "bbbandroidHAL.h"
+#include "gpio_internal.h"
 
-#define SYSFS_PWM_DIR "/sys/class/pwm"	/**< File system path to access PWM */
+#ifndef SYSFS_PWM_DIR
+#define SYSFS_PWM_DIR "/sys/class/pwm"	/**< File system path to access PWM, the host tests use a fake tree */
+#endif
+#define MAX_PWM_CHANNELS 8	/**< Number of PWM channels with a shadow in pwmConfigure() */
+
+#define PWM_ATTR_PERIOD   0	/**< Index of period_ns in PWMChannel_t */
+#define PWM_ATTR_DUTY     1	/**< Index of duty_ns in PWMChannel_t */
+#define PWM_ATTR_POLARITY 2	/**< Index of polarity in PWMChannel_t */
+#define PWM_ATTR_RUN      3	/**< Index of run in PWMChannel_t */
+#define PWM_TEXT_SIZE     12	/**< Size of an attribute value formatted as text */
+
+#ifndef PWM_MEM_DEV
+#define PWM_MEM_DEV         "/dev/mem"	/**< Device mapped for the EHRPWM registers, the host tests map a register file instead */
+#endif
+#define EHRPWM_MODULES      3		/**< Number of PWMSS modules with an EHRPWM */
+#define EHRPWM_OFFSET       0x200	/**< Offset of the EHRPWM registers in a PWMSS module */
+#define PWMSS_CLKSTATUS     0x0C	/**< PWMSS clock status register */
+#define PWMSS_EPWM_CLK      (1 << 8)	/**< EHRPWM clock running bit of PWMSS_CLKSTATUS */
+#define EHRPWM_TICK_NS      10		/**< Time base count of the 100 MHz functional clock before CLKDIV */
+#define EHRPWM_CLKDIV_MAX   7		/**< Largest CLKDIV, dividing by 128 */
+
+/* EHRPWM registers are 16 bit, these are indices of uint16_t */
+#define EHRPWM_TBCTL        0x00	/**< Time base control */
+#define EHRPWM_TBPRD        0x05	/**< Time base period, shadowed */
+#define EHRPWM_CMPCTL       0x07	/**< Counter compare control */
+#define EHRPWM_CMPA         0x09	/**< Counter compare A, shadowed, CMPB follows it */
+#define EHRPWM_AQCTLA       0x0B	/**< Action qualifier of output A, AQCTLB follows it */
+#define EHRPWM_AQSFRC       0x0D	/**< Action qualifier software force */
+#define EHRPWM_AQCSFRC      0x0E	/**< Action qualifier continuous software force */
+
+#define EHRPWM_TBCTL_DIV    0x1F80	/**< CLKDIV and HSPCLKDIV bits of TBCTL */
+#define EHRPWM_TBCTL_MODE   0x000B	/**< PRDLD and CTRMODE bits of TBCTL */
+#define EHRPWM_CMPCTL_CLEAR 0x005F	/**< Shadow and load mode bits of CMPCTL */
+#define EHRPWM_RLDCSF_NOW   0x00C0	/**< AQSFRC bits making AQCSFRC take effect immediately */
+
+/**
+ * typedef struct EHRPWMModule_t for a mapped PWMSS module.
+ */
+
+typedef struct {
+	volatile uint32_t *base;	/**< Mapped PWMSS registers, NULL if not mapped */
+	volatile uint16_t *regs;	/**< EHRPWM registers inside base */
+	int clkdiv;			/**< CLKDIV programmed in TBCTL, -1 if not programmed yet */
+} EHRPWMModule_t;
+
+/**
+ * typedef struct PWMChannel_t for storing the open attribute files of a channel
+ * and the values last written to them.
+ */
+
+typedef struct {
+	int fd[4];		/**< File descriptors of period_ns, duty_ns, polarity and run, -1 if not open */
+	uint32_t value[4];	/**< Values of the attributes */
+	int valid;		/**< Non zero if value holds what the attributes contain */
+	int backend;		/**< PWM_BACKEND_SYSFS or PWM_BACKEND_MMAP */
+} PWMChannel_t;
+
+/**
+ * struct PWMGroup for a set of channels updated together, created by pwmGroupCreate().
+ */
+
+struct PWMGroup {
+	int count;					/**< Number of channels */
+	uint8_t channel[MAX_PWM_CHANNELS];		/**< Channels of the group */
+	uint32_t period[MAX_PWM_CHANNELS];		/**< Staged period of each channel */
+	uint32_t duty[MAX_PWM_CHANNELS];		/**< Staged duty of each channel */
+	char periodText[MAX_PWM_CHANNELS][PWM_TEXT_SIZE];	/**< Staged period formatted for the period_ns file */
+	char dutyText[MAX_PWM_CHANNELS][PWM_TEXT_SIZE];	/**< Staged duty formatted for the duty_ns file */
+	int periodLen[MAX_PWM_CHANNELS];		/**< Length of periodText */
+	int dutyLen[MAX_PWM_CHANNELS];			/**< Length of dutyText */
+	int staged[MAX_PWM_CHANNELS];			/**< Non zero if the channel has values staged */
+	uint32_t lastLatency;				/**< Duration of the last commit in nano seconds */
+	uint32_t maxLatency;				/**< Longest commit in nano seconds */
+};
+
+static const char *pwmAttrs[] = { "period_ns", "duty_ns", "polarity", "run" };	/**< Attribute file names */
 
 static char fsBuf[100];	/**< Buffer to store generated file system path using snprintf */
+static pthread_mutex_t pwmLock = PTHREAD_MUTEX_INITIALIZER;	/**< Guards fsBuf, the shadows, the open files and the EHRPWM registers */
+static PWMChannel_t pwmChannels[MAX_PWM_CHANNELS];	/**< Shadow state of each channel */
+static int pwmChannelsInit = 0;	/**< Non zero once the fd arrays are set to -1 */
+
+static const uint32_t pwmssAddrs[EHRPWM_MODULES] =
+	{ 0x48300000, 0x48302000, 0x48304000 };	/**< PWMSS module addresses */
+static const int ehrpwmModule[MAX_PWM_CHANNELS] =
+	{ 0, 0, -1, 1, 1, 2, 2, -1 };	/**< EHRPWM module of each channel, -1 for the eCAP channels */
+static const int ehrpwmOutput[MAX_PWM_CHANNELS] =
+	{ 0, 1, 0, 0, 1, 0, 1, 0 };	/**< Output of each channel, 0 for A and 1 for B */
+static const int ehrpwmSibling[MAX_PWM_CHANNELS] =
+	{ 1, 0, 2, 4, 3, 6, 5, 7 };	/**< Channel on the other output of the same module */
+static const uint16_t ehrpwmActions[2][2] =
+	{ { 0x0012, 0x0021 }, { 0x0102, 0x0201 } };	/**< AQCTLA and AQCTLB for normal and inverted polarity */
+static EHRPWMModule_t ehrpwmModules[EHRPWM_MODULES];	/**< Mapped modules */
+static int fdPWM = -1;	/**< File descriptor of PWM_MEM_DEV */
+
+/**
+ * This function sets the cached file descriptors of all channels to -1 on first use.
+ */
+
+static void pwmChannelsSetup(void)
+{
+	int i, j;
+
+	if (pwmChannelsInit)
+		return;
+
+	for (i = 0; i < MAX_PWM_CHANNELS; i++)
+		for (j = 0; j < 4; j++)
+			pwmChannels[i].fd[j] = -1;
+	pwmChannelsInit = 1;
+}
+
+/**
+ * This function forgets the shadow of a channel after it was changed behind pwmConfigure().
+ * @param channel a constant uint8_t argument.
+ */
+
+static void pwmInvalidate(const uint8_t channel)
+{
+	if (channel < MAX_PWM_CHANNELS)
+		pwmChannels[channel].valid = 0;
+}
+
+/**
+ * This function tells whether a channel uses the EHRPWM register backend.
+ * @param channel a constant uint8_t argument.
+ * @return 1 if the channel is memory mapped and 0 otherwise.
+ */
+
+static int pwmIsMmap(const uint8_t channel)
+{
+	return (channel < MAX_PWM_CHANNELS) && (pwmChannels[channel].backend == PWM_BACKEND_MMAP);
+}
+
+static int pwmChannelConfigure(const uint8_t channel, const uint32_t period_ns, const uint32_t duty_ns,
+	const uint8_t polarity, const uint8_t run);
+
+/**
+ * This function changes one attribute of a memory mapped channel through pwmConfigure().
+ * @param channel a constant uint8_t argument.
+ * @param attr a constant integer argument, one of the PWM_ATTR_ values.
+ * @param value a constant uint32_t argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int pwmSetAttr(const uint8_t channel, const int attr, const uint32_t value)
+{
+	uint32_t v[4];
+	int ret;
+
+	pthread_mutex_lock(&pwmLock);
+	memcpy(v, pwmChannels[channel].value, sizeof(v));
+	v[attr] = value;
+	ret = pwmChannelConfigure(channel, v[PWM_ATTR_PERIOD], v[PWM_ATTR_DUTY], v[PWM_ATTR_POLARITY],
+		v[PWM_ATTR_RUN]);
+	pthread_mutex_unlock(&pwmLock);
+
+	return ret;
+}
+
+/**
+ * This function reads one attribute of a memory mapped channel from its shadow.
+ * @param channel a constant uint8_t argument.
+ * @param attr a constant integer argument, one of the PWM_ATTR_ values.
+ * @return value of the attribute.
+ */
+
+static int pwmShadowValue(const uint8_t channel, const int attr)
+{
+	int value;
+
+	pthread_mutex_lock(&pwmLock);
+	value = pwmChannels[channel].value[attr];
+	pthread_mutex_unlock(&pwmLock);
+
+	return value;
+}
 
 /**
  * It takes channel and period to be assigned in nano seconds 
@@ -31,9 +214,14 @@ int pwmSetPeriod(const uint8_t channel, const uint32_t period_ns)
 {
 	FILE *fd;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/period_ns", channel);
+	if (pwmIsMmap(channel))
+		return pwmSetAttr(channel, PWM_ATTR_PERIOD, period_ns);
 
+	pthread_mutex_lock(&pwmLock);
+	pwmInvalidate(channel);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/period_ns", channel);
 	fd = fopen(fsBuf, "w");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -58,9 +246,13 @@ int pwmGetPeriod(const uint8_t channel)
 	FILE *fd;
 	int value;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/period_ns", channel);
+	if (pwmIsMmap(channel))
+		return pwmShadowValue(channel, PWM_ATTR_PERIOD);
 
+	pthread_mutex_lock(&pwmLock);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/period_ns", channel);
 	fd = fopen(fsBuf, "r");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -85,9 +277,14 @@ int pwmSetDutyCycle(const uint8_t channel, const uint32_t duration_ns)
 {
 	FILE *fd;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/duty_ns", channel);
+	if (pwmIsMmap(channel))
+		return pwmSetAttr(channel, PWM_ATTR_DUTY, duration_ns);
 
+	pthread_mutex_lock(&pwmLock);
+	pwmInvalidate(channel);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/duty_ns", channel);
 	fd = fopen(fsBuf, "w");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -112,9 +309,13 @@ int pwmGetDutyCycle(const uint8_t channel)
 	FILE *fd;
 	int value;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/duty_ns", channel);
+	if (pwmIsMmap(channel))
+		return pwmShadowValue(channel, PWM_ATTR_DUTY);
 
+	pthread_mutex_lock(&pwmLock);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/duty_ns", channel);
 	fd = fopen(fsBuf, "r");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -139,9 +340,14 @@ int pwmSetPolarity(const uint8_t channel, const uint8_t polarity)
 {
 	FILE *fd;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/polarity", channel);
+	if (pwmIsMmap(channel))
+		return pwmSetAttr(channel, PWM_ATTR_POLARITY, polarity);
 
+	pthread_mutex_lock(&pwmLock);
+	pwmInvalidate(channel);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/polarity", channel);
 	fd = fopen(fsBuf, "w");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -166,9 +372,13 @@ int pwmGetPolarity(const uint8_t channel)
 	FILE *fd;
 	int value;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/polarity", channel);
+	if (pwmIsMmap(channel))
+		return pwmShadowValue(channel, PWM_ATTR_POLARITY);
 
+	pthread_mutex_lock(&pwmLock);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/polarity", channel);
 	fd = fopen(fsBuf, "r");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -192,9 +402,14 @@ int pwmRun(const uint8_t channel)
 {
 	FILE *fd;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/run", channel);
+	if (pwmIsMmap(channel))
+		return pwmSetAttr(channel, PWM_ATTR_RUN, 1);
 
+	pthread_mutex_lock(&pwmLock);
+	pwmInvalidate(channel);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/run", channel);
 	fd = fopen(fsBuf, "w");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -218,9 +433,14 @@ int pwmStop(const uint8_t channel)
 {
 	FILE *fd;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/run", channel);
+	if (pwmIsMmap(channel))
+		return pwmSetAttr(channel, PWM_ATTR_RUN, 0);
 
+	pthread_mutex_lock(&pwmLock);
+	pwmInvalidate(channel);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/run", channel);
 	fd = fopen(fsBuf, "w");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -245,9 +465,13 @@ int pwmRunCheck(const uint8_t channel)
 	FILE *fd;
 	int value;
 	
-	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/run", channel);
+	if (pwmIsMmap(channel))
+		return pwmShadowValue(channel, PWM_ATTR_RUN);
 
+	pthread_mutex_lock(&pwmLock);
+	snprintf(fsBuf, sizeof(fsBuf), SYSFS_PWM_DIR "/pwm%d/run", channel);
 	fd = fopen(fsBuf, "r");
+	pthread_mutex_unlock(&pwmLock);
 
 	if (fd == NULL) 
 	{
@@ -258,4 +482,596 @@ int pwmRunCheck(const uint8_t channel)
   	fclose(fd);
 
   	return value;
-}
\ No newline at end of file
+}
+
+/**
+ * This function opens the attribute files of a channel and loads its shadow from them.
+ * @param ch a PWMChannel_t pointer argument.
+ * @param channel a constant uint8_t argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int pwmChannelLoad(PWMChannel_t *ch, const uint8_t channel)
+{
+	char path[64], buf[16];
+	int i, n;
+
+	for (i = 0; i < 4; i++) {
+		if (ch->fd[i] < 0) {
+			snprintf(path, sizeof(path), SYSFS_PWM_DIR "/pwm%d/%s", channel, pwmAttrs[i]);
+			ch->fd[i] = open(path, O_RDWR);
+			if (ch->fd[i] < 0)
+				return -1;
+		}
+
+		n = pread(ch->fd[i], buf, sizeof(buf) - 1, 0);
+		if (n <= 0)
+			return -1;
+		buf[n] = '\0';
+		ch->value[i] = strtoul(buf, NULL, 10);
+	}
+
+	ch->valid = 1;
+	return 0;
+}
+
+/**
+ * This function writes one attribute of a channel already formatted as text and updates the shadow.
+ * @param ch a PWMChannel_t pointer argument.
+ * @param attr a constant integer argument, one of the PWM_ATTR_ values.
+ * @param value a constant uint32_t argument.
+ * @param text a constant char array argument, value in decimal.
+ * @param len a constant integer argument, length of text.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int pwmChannelWriteText(PWMChannel_t *ch, const int attr, const uint32_t value,
+	const char *text, const int len)
+{
+	if (pwrite(ch->fd[attr], text, len, 0) != len) {
+		ch->valid = 0;
+		return -1;
+	}
+
+	ch->value[attr] = value;
+	return 0;
+}
+
+/**
+ * This function writes one attribute of a channel through its open file and updates the shadow.
+ * @param ch a PWMChannel_t pointer argument.
+ * @param attr a constant integer argument, one of the PWM_ATTR_ values.
+ * @param value a constant uint32_t argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int pwmChannelWrite(PWMChannel_t *ch, const int attr, const uint32_t value)
+{
+	char buf[PWM_TEXT_SIZE];
+
+	return pwmChannelWriteText(ch, attr, value, buf, snprintf(buf, sizeof(buf), "%u", value));
+}
+
+/**
+ * This function maps the registers of a PWMSS module if they are not mapped yet.
+ * @param module a constant integer argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int ehrpwmMap(const int module)
+{
+	EHRPWMModule_t *mod = &ehrpwmModules[module];
+	volatile uint32_t *map;
+
+	if (mod->base != NULL)
+		return 0;
+
+	if (fdPWM < 0) {
+		fdPWM = open(PWM_MEM_DEV, O_RDWR | O_SYNC);
+		if (fdPWM < 0) {
+			printf("PWM: errno[%d]: '%s'\n", errno, strerror(errno));
+			return -1;
+		}
+	}
+
+	map = (volatile uint32_t *) mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE, MAP_SHARED, fdPWM, pwmssAddrs[module]);
+	if (map == (uint32_t *)-1) {
+		printf("PWM: errno[%d]: '%s'\n", errno, strerror(errno));
+		return -1;
+	}
+
+	/* The kernel driver turns the EHRPWM clock on, registers of a stopped module are not accessible */
+	if (!(map[PWMSS_CLKSTATUS/4] & PWMSS_EPWM_CLK)) {
+		munmap((void *) map, getpagesize());
+		return -1;
+	}
+
+	mod->base = map;
+	mod->regs = (volatile uint16_t *) ((volatile uint8_t *) map + EHRPWM_OFFSET);
+	mod->clkdiv = -1;
+	return 0;
+}
+
+/**
+ * This function converts a duty to a compare value. Values past the period are clamped to
+ * 0xFFFF, which is past any TBPRD used and keeps the output active.
+ * @param duty_ns a constant uint32_t argument.
+ * @param clkdiv a constant integer argument.
+ * @return compare value.
+ */
+
+static uint16_t ehrpwmCompare(const uint32_t duty_ns, const int clkdiv)
+{
+	uint32_t cmp = duty_ns / (EHRPWM_TICK_NS << clkdiv);
+
+	return (cmp > 0xFFFF) ? 0xFFFF : cmp;
+}
+
+/**
+ * This function configures a memory mapped channel with register stores. TBPRD and CMPA/CMPB
+ * are shadowed and loaded when the counter wraps to zero, so a new period and duty take effect
+ * together at the next period boundary. Stopping forces the output to its inactive level.
+ * The two outputs of a module share the time base, so a period change applies to both and is
+ * refused while the other memory mapped output has a longer duty.
+ * @param ch a PWMChannel_t pointer argument.
+ * @param channel a constant uint8_t argument.
+ * @param period_ns a constant uint32_t argument.
+ * @param duty_ns a constant uint32_t argument.
+ * @param polarity a constant uint8_t argument.
+ * @param run a constant uint8_t argument.
+ * @return 0 on success and -1 if the period does not fit the time base or the other output.
+ */
+
+static int ehrpwmConfigure(PWMChannel_t *ch, const uint8_t channel, const uint32_t period_ns,
+	const uint32_t duty_ns, const uint8_t polarity, const uint8_t run)
+{
+	EHRPWMModule_t *mod = &ehrpwmModules[ehrpwmModule[channel]];
+	PWMChannel_t *sibling = &pwmChannels[ehrpwmSibling[channel]];
+	volatile uint16_t *regs = mod->regs;
+	int out = ehrpwmOutput[channel];
+	int clkdiv, rescaled = 0;
+	uint16_t force;
+
+	if ((period_ns != ch->value[PWM_ATTR_PERIOD]) || (mod->clkdiv < 0)) {
+		for (clkdiv = 0; clkdiv < EHRPWM_CLKDIV_MAX; clkdiv++)
+			if (period_ns / (EHRPWM_TICK_NS << clkdiv) <= 0xFFFF)
+				break;
+		if ((period_ns < 2 * EHRPWM_TICK_NS) || (period_ns / (EHRPWM_TICK_NS << clkdiv) > 0xFFFF))
+			return -1;
+
+		/* The other output keeps its duty, so the period may not shrink below it */
+		if ((sibling->backend == PWM_BACKEND_MMAP) && (sibling->value[PWM_ATTR_DUTY] > period_ns))
+			return -1;
+
+		/* The prescaler is not shadowed, the other output is rescaled right after it */
+		if (clkdiv != mod->clkdiv) {
+			regs[EHRPWM_TBCTL] = (regs[EHRPWM_TBCTL] & ~EHRPWM_TBCTL_DIV) | (clkdiv << 10);
+			mod->clkdiv = clkdiv;
+			rescaled = 1;
+			if (sibling->backend == PWM_BACKEND_MMAP)
+				regs[EHRPWM_CMPA + ehrpwmOutput[ehrpwmSibling[channel]]] =
+					ehrpwmCompare(sibling->value[PWM_ATTR_DUTY], clkdiv);
+		}
+
+		regs[EHRPWM_TBPRD] = period_ns / (EHRPWM_TICK_NS << clkdiv) - 1;
+		ch->value[PWM_ATTR_PERIOD] = period_ns;
+		if (sibling->backend == PWM_BACKEND_MMAP)
+			sibling->value[PWM_ATTR_PERIOD] = period_ns;
+		else
+			sibling->valid = 0;
+	}
+
+	/* A compare value past TBPRD never matches and keeps the output active */
+	if ((duty_ns != ch->value[PWM_ATTR_DUTY]) || rescaled) {
+		regs[EHRPWM_CMPA + out] = ehrpwmCompare(duty_ns, mod->clkdiv);
+		ch->value[PWM_ATTR_DUTY] = duty_ns;
+	}
+
+	if (polarity != ch->value[PWM_ATTR_POLARITY])
+		regs[EHRPWM_AQCTLA + out] = ehrpwmActions[out][polarity != 0];
+
+	if ((polarity != ch->value[PWM_ATTR_POLARITY]) || ((run != 0) != ch->value[PWM_ATTR_RUN])) {
+		force = run ? 0 : (polarity ? 2 : 1);
+		regs[EHRPWM_AQCSFRC] = (regs[EHRPWM_AQCSFRC] & ~(3 << (out * 2))) | (force << (out * 2));
+		ch->value[PWM_ATTR_POLARITY] = polarity;
+		ch->value[PWM_ATTR_RUN] = run != 0;
+	}
+
+	return 0;
+}
+
+/**
+ * This function is pwmConfigure() for callers already holding pwmLock.
+ * @param channel a constant uint8_t argument.
+ * @param period_ns a constant uint32_t argument.
+ * @param duty_ns a constant uint32_t argument, not more than period_ns.
+ * @param polarity a constant uint8_t argument.
+ * @param run a constant uint8_t argument, non zero to run the channel.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int pwmChannelConfigure(const uint8_t channel, const uint32_t period_ns, const uint32_t duty_ns,
+	const uint8_t polarity, const uint8_t run)
+{
+	PWMChannel_t *ch;
+
+	if ((channel >= MAX_PWM_CHANNELS) || (duty_ns > period_ns))
+		return -1;
+
+	pwmChannelsSetup();
+	ch = &pwmChannels[channel];
+	if (ch->backend == PWM_BACKEND_MMAP)
+		return ehrpwmConfigure(ch, channel, period_ns, duty_ns, polarity, run);
+
+	if (!ch->valid && pwmChannelLoad(ch, channel))
+		return -1;
+
+	if ((ch->value[PWM_ATTR_POLARITY] != polarity) && ch->value[PWM_ATTR_RUN])
+		if (pwmChannelWrite(ch, PWM_ATTR_RUN, 0))
+			return -1;
+
+	/* Growing the period past the old one has to come first, otherwise the duty goes first */
+	if (duty_ns > ch->value[PWM_ATTR_PERIOD]) {
+		if (pwmChannelWrite(ch, PWM_ATTR_PERIOD, period_ns))
+			return -1;
+	}
+
+	if (ch->value[PWM_ATTR_DUTY] != duty_ns)
+		if (pwmChannelWrite(ch, PWM_ATTR_DUTY, duty_ns))
+			return -1;
+
+	if (ch->value[PWM_ATTR_PERIOD] != period_ns)
+		if (pwmChannelWrite(ch, PWM_ATTR_PERIOD, period_ns))
+			return -1;
+
+	if (ch->value[PWM_ATTR_POLARITY] != polarity)
+		if (pwmChannelWrite(ch, PWM_ATTR_POLARITY, polarity))
+			return -1;
+
+	if (ch->value[PWM_ATTR_RUN] != (run != 0))
+		if (pwmChannelWrite(ch, PWM_ATTR_RUN, run != 0))
+			return -1;
+
+	return 0;
+}
+
+/**
+ * It takes channel, period, duty cycle, polarity and run and configures the channel in one call.
+ * The attribute files stay open between calls and only the attributes that differ from the
+ * last values are written, in an order the kernel accepts: the duty never exceeds the period
+ * on the way, and the channel is stopped while its polarity changes.
+ * Channels switched to PWM_BACKEND_MMAP are configured with register stores instead.
+ * All pwm* calls are serialized, so other channels can be used while pwmStreamStart() or
+ * pwmServoStart() drive theirs.
+ * @param channel a constant uint8_t argument.
+ * @param period_ns a constant uint32_t argument.
+ * @param duty_ns a constant uint32_t argument, not more than period_ns.
+ * @param polarity a constant uint8_t argument.
+ * @param run a constant uint8_t argument, non zero to run the channel.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmConfigure(const uint8_t channel, const uint32_t period_ns, const uint32_t duty_ns,
+	const uint8_t polarity, const uint8_t run)
+{
+	int ret;
+
+	pthread_mutex_lock(&pwmLock);
+	ret = pwmChannelConfigure(channel, period_ns, duty_ns, polarity, run);
+	pthread_mutex_unlock(&pwmLock);
+
+	return ret;
+}
+
+/**
+ * This function is pwmSetBackend() for callers already holding pwmLock.
+ * @param channel a constant uint8_t argument.
+ * @param backend a constant integer argument, PWM_BACKEND_SYSFS or PWM_BACKEND_MMAP.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int pwmChannelSetBackend(const uint8_t channel, const int backend)
+{
+	PWMChannel_t *ch;
+	EHRPWMModule_t *mod;
+	uint32_t v[4], duty;
+	int out;
+
+	if ((channel >= MAX_PWM_CHANNELS) || ((backend != PWM_BACKEND_SYSFS) && (backend != PWM_BACKEND_MMAP)))
+		return -1;
+
+	pwmChannelsSetup();
+	ch = &pwmChannels[channel];
+	if (ch->backend == backend)
+		return 0;
+
+	out = ehrpwmOutput[channel];
+
+	if (backend == PWM_BACKEND_SYSFS) {
+		mod = &ehrpwmModules[ehrpwmModule[channel]];
+		mod->regs[EHRPWM_AQCSFRC] &= ~(3 << (out * 2));
+		ch->backend = PWM_BACKEND_SYSFS;
+		ch->valid = 0;
+		return 0;
+	}
+
+	if ((ehrpwmModule[channel] < 0) || (!ch->valid && pwmChannelLoad(ch, channel)))
+		return -1;
+
+	/* Run it with duty 0 so the output stays inactive until the registers are programmed */
+	memcpy(v, ch->value, sizeof(v));
+	duty = v[PWM_ATTR_DUTY];
+	if (pwmChannels[ehrpwmSibling[channel]].backend == PWM_BACKEND_MMAP) {
+		v[PWM_ATTR_PERIOD] = pwmChannels[ehrpwmSibling[channel]].value[PWM_ATTR_PERIOD];
+		if (v[PWM_ATTR_DUTY] > v[PWM_ATTR_PERIOD])
+			v[PWM_ATTR_DUTY] = v[PWM_ATTR_PERIOD];
+	}
+	if (!ch->value[PWM_ATTR_RUN] &&
+	    (pwmChannelWrite(ch, PWM_ATTR_DUTY, 0) || pwmChannelWrite(ch, PWM_ATTR_RUN, 1)))
+		return -1;
+
+	if (ehrpwmMap(ehrpwmModule[channel])) {
+		/* Leave a channel that was stopped the way it was found */
+		if (!v[PWM_ATTR_RUN]) {
+			pwmChannelWrite(ch, PWM_ATTR_RUN, 0);
+			pwmChannelWrite(ch, PWM_ATTR_DUTY, duty);
+		}
+		return -1;
+	}
+
+	/* Up counting, TBPRD and CMPx shadowed and loaded at zero, forces applied immediately */
+	mod = &ehrpwmModules[ehrpwmModule[channel]];
+	mod->regs[EHRPWM_TBCTL] &= ~EHRPWM_TBCTL_MODE;
+	mod->regs[EHRPWM_CMPCTL] &= ~EHRPWM_CMPCTL_CLEAR;
+	mod->regs[EHRPWM_AQSFRC] |= EHRPWM_RLDCSF_NOW;
+
+	/* Values nothing matches, so every register is written */
+	ch->value[PWM_ATTR_PERIOD] = 0;
+	ch->value[PWM_ATTR_DUTY] = ch->value[PWM_ATTR_POLARITY] = ch->value[PWM_ATTR_RUN] = 0xFFFFFFFF;
+	ch->backend = PWM_BACKEND_MMAP;
+	ch->valid = 1;
+
+	if (ehrpwmConfigure(ch, channel, v[PWM_ATTR_PERIOD], v[PWM_ATTR_DUTY], v[PWM_ATTR_POLARITY],
+	    v[PWM_ATTR_RUN])) {
+		ch->backend = PWM_BACKEND_SYSFS;
+		ch->valid = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * It takes a channel and a backend and picks how the channel is driven. PWM_BACKEND_SYSFS goes
+ * through the attribute files, PWM_BACKEND_MMAP stores to the EHRPWM registers directly, with
+ * duty and period changes taking effect at the next period boundary. Only the six EHRPWM
+ * channels (0, 1, 3, 4, 5, 6) can be memory mapped, not the eCAP ones.
+ * The channel is started through the file system first, so the kernel turns on its clocks and
+ * the pin mux, and then keeps its period, duty, polarity and run state. Both outputs of a module
+ * share one time base and should use the same backend; a channel joining a memory mapped one
+ * takes over its period.
+ * @param channel a constant uint8_t argument.
+ * @param backend a constant integer argument, PWM_BACKEND_SYSFS or PWM_BACKEND_MMAP.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmSetBackend(const uint8_t channel, const int backend)
+{
+	int ret;
+
+	pthread_mutex_lock(&pwmLock);
+	ret = pwmChannelSetBackend(channel, backend);
+	pthread_mutex_unlock(&pwmLock);
+
+	return ret;
+}
+
+/**
+ * For closing the attribute files kept open by pwmConfigure() and unmapping the EHRPWM registers.
+ * Memory mapped channels go back to the file system backend and keep their last configuration.
+ */
+
+void pwmClose(void)
+{
+	int i, j;
+
+	pthread_mutex_lock(&pwmLock);
+	if (!pwmChannelsInit) {
+		pthread_mutex_unlock(&pwmLock);
+		return;
+	}
+
+	for (i = 0; i < MAX_PWM_CHANNELS; i++) {
+		for (j = 0; j < 4; j++) {
+			if (pwmChannels[i].fd[j] >= 0)
+				close(pwmChannels[i].fd[j]);
+			pwmChannels[i].fd[j] = -1;
+		}
+		pwmChannels[i].valid = 0;
+		pwmChannels[i].backend = PWM_BACKEND_SYSFS;
+	}
+
+	for (i = 0; i < EHRPWM_MODULES; i++) {
+		if (ehrpwmModules[i].base != NULL)
+			munmap((void *) ehrpwmModules[i].base, getpagesize());
+		ehrpwmModules[i].base = NULL;
+		ehrpwmModules[i].regs = NULL;
+	}
+
+	if (fdPWM >= 0)
+		close(fdPWM);
+	fdPWM = -1;
+	pthread_mutex_unlock(&pwmLock);
+}
+
+/**
+ * It takes an array of channels and creates a group to update them together.
+ * The attribute files of sysfs channels are opened here, not in pwmGroupCommit().
+ * @param channels a constant uint8_t array argument.
+ * @param count a constant integer argument, at most 8.
+ * @see pwmGroupSet()
+ * @see pwmGroupCommit()
+ * @return pointer to the group on success and NULL if it fails.
+ */
+
+PWMGroup_t *pwmGroupCreate(const uint8_t channels[], const int count)
+{
+	PWMGroup_t *group;
+	PWMChannel_t *ch;
+	int i;
+
+	if ((count <= 0) || (count > MAX_PWM_CHANNELS))
+		return NULL;
+
+	pthread_mutex_lock(&pwmLock);
+	pwmChannelsSetup();
+	for (i = 0; i < count; i++) {
+		if (channels[i] >= MAX_PWM_CHANNELS)
+			break;
+		ch = &pwmChannels[channels[i]];
+		if (!ch->valid && pwmChannelLoad(ch, channels[i]))
+			break;
+	}
+	pthread_mutex_unlock(&pwmLock);
+	if (i < count)
+		return NULL;
+
+	group = (PWMGroup_t *) calloc(1, sizeof(PWMGroup_t));
+	if (group == NULL)
+		return NULL;
+
+	group->count = count;
+	memcpy(group->channel, channels, count);
+	return group;
+}
+
+/**
+ * It takes a group, the index of a channel in it and new period and duty cycle and stages them
+ * for the next pwmGroupCommit(). Values are checked and formatted here so the commit only writes.
+ * @param group a PWMGroup_t pointer argument.
+ * @param index a constant integer argument, position of the channel in pwmGroupCreate().
+ * @param period_ns a constant uint32_t argument.
+ * @param duty_ns a constant uint32_t argument, not more than period_ns.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmGroupSet(PWMGroup_t *group, const int index, const uint32_t period_ns, const uint32_t duty_ns)
+{
+	if ((group == NULL) || (index < 0) || (index >= group->count) || (duty_ns > period_ns))
+		return -1;
+
+	group->period[index] = period_ns;
+	group->duty[index] = duty_ns;
+	group->periodLen[index] = snprintf(group->periodText[index], PWM_TEXT_SIZE, "%u", period_ns);
+	group->dutyLen[index] = snprintf(group->dutyText[index], PWM_TEXT_SIZE, "%u", duty_ns);
+	group->staged[index] = 1;
+	return 0;
+}
+
+/**
+ * It takes a group and applies all staged values as one batch, skipping values the channels
+ * already have. Memory mapped channels are updated first since they only take register stores,
+ * then the sysfs channels in two passes: first every write that can go on its own (the duty,
+ * or the period when it has to grow first), then the rest. Most visible changes are so made
+ * back to back instead of one channel after another.
+ * @param group a PWMGroup_t pointer argument.
+ * @see pwmGroupLatency()
+ * @return 0 on success and -1 if any channel failed.
+ */
+
+int pwmGroupCommit(PWMGroup_t *group)
+{
+	PWMChannel_t *ch;
+	uint64_t start;
+	uint32_t latency;
+	int i, ret = 0;
+
+	if (group == NULL)
+		return -1;
+
+	pthread_mutex_lock(&pwmLock);
+
+	/* Shadows lost to the legacy setters are reloaded before the clock starts */
+	for (i = 0; i < group->count; i++) {
+		ch = &pwmChannels[group->channel[i]];
+		if (group->staged[i] && !ch->valid && pwmChannelLoad(ch, group->channel[i])) {
+			pthread_mutex_unlock(&pwmLock);
+			return -1;
+		}
+	}
+
+	start = gpioClockNs(CLOCK_MONOTONIC_RAW);
+
+	for (i = 0; i < group->count; i++) {
+		ch = &pwmChannels[group->channel[i]];
+		if (group->staged[i] && (ch->backend == PWM_BACKEND_MMAP))
+			ret |= ehrpwmConfigure(ch, group->channel[i], group->period[i], group->duty[i],
+				ch->value[PWM_ATTR_POLARITY], ch->value[PWM_ATTR_RUN]);
+	}
+
+	for (i = 0; i < group->count; i++) {
+		ch = &pwmChannels[group->channel[i]];
+		if (!group->staged[i] || (ch->backend == PWM_BACKEND_MMAP))
+			continue;
+		if (group->duty[i] > ch->value[PWM_ATTR_PERIOD])
+			ret |= pwmChannelWriteText(ch, PWM_ATTR_PERIOD, group->period[i],
+				group->periodText[i], group->periodLen[i]);
+		else if (group->duty[i] != ch->value[PWM_ATTR_DUTY])
+			ret |= pwmChannelWriteText(ch, PWM_ATTR_DUTY, group->duty[i],
+				group->dutyText[i], group->dutyLen[i]);
+	}
+
+	for (i = 0; i < group->count; i++) {
+		ch = &pwmChannels[group->channel[i]];
+		if (!group->staged[i] || (ch->backend == PWM_BACKEND_MMAP) || !ch->valid)
+			continue;
+		if (group->duty[i] != ch->value[PWM_ATTR_DUTY])
+			ret |= pwmChannelWriteText(ch, PWM_ATTR_DUTY, group->duty[i],
+				group->dutyText[i], group->dutyLen[i]);
+		if (group->period[i] != ch->value[PWM_ATTR_PERIOD])
+			ret |= pwmChannelWriteText(ch, PWM_ATTR_PERIOD, group->period[i],
+				group->periodText[i], group->periodLen[i]);
+	}
+
+	latency = gpioClockNs(CLOCK_MONOTONIC_RAW) - start;
+	pthread_mutex_unlock(&pwmLock);
+
+	group->lastLatency = latency;
+	if (latency > group->maxLatency)
+		group->maxLatency = latency;
+
+	for (i = 0; i < group->count; i++)
+		group->staged[i] = 0;
+
+	return ret ? -1 : 0;
+}
+
+/**
+ * It takes a group and returns how long its commits took, from the first write to the last.
+ * @param group a constant PWMGroup_t pointer argument.
+ * @param last_ns a uint32_t pointer argument, set to the duration of the last commit, may be NULL.
+ * @param max_ns a uint32_t pointer argument, set to the longest commit so far, may be NULL.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmGroupLatency(const PWMGroup_t *group, uint32_t *last_ns, uint32_t *max_ns)
+{
+	if (group == NULL)
+		return -1;
+
+	if (last_ns != NULL)
+		*last_ns = group->lastLatency;
+	if (max_ns != NULL)
+		*max_ns = group->maxLatency;
+	return 0;
+}
+
+/**
+ * For freeing a group created by pwmGroupCreate(). The channels keep their configuration.
+ * @param group a PWMGroup_t pointer argument.
+ */
+
+void pwmGroupFree(PWMGroup_t *group)
+{
+	free(group);
+}
@@ -0,0 +1,300 @@
+/**********************************************************
+  Servo control code with calibrated angle tables and
+    slew rate limiting over PWM channels
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file pwm_servo.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Servo control code with calibrated angle tables and slew rate limiting over PWM channels
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define MAX_SERVOS        8	/**< Maximum number of servos, one per PWM channel */
+#define SERVO_LUT_SIZE    361	/**< Entries of an angle table, one per degree of a full turn */
+#define SERVO_NO_TARGET   INT32_MIN	/**< Target of a servo not commanded yet */
+
+/**
+ * typedef struct PWMServo_t for one servo.
+ */
+
+typedef struct {
+	uint8_t channel;		/**< PWM channel driving the servo */
+	uint32_t period;		/**< Frame period in nano seconds */
+	int32_t minAngle;		/**< Lowest angle in milli degrees */
+	int32_t maxAngle;		/**< Highest angle in milli degrees */
+	uint32_t lut[SERVO_LUT_SIZE];	/**< Pulse in nano seconds for each whole degree from minAngle */
+	int32_t target;			/**< Target angle in milli degrees, SERVO_NO_TARGET before the first one */
+	int32_t slew;			/**< Maximum speed in milli degrees per second, 0 for none */
+	int32_t position;		/**< Angle commanded on the last tick in milli degrees */
+	uint32_t pulse;			/**< Pulse commanded on the last tick in nano seconds */
+} PWMServo_t;
+
+static PWMServo_t servos[MAX_SERVOS];	/**< Added servos */
+static int servoCount = 0;		/**< Number of servos */
+static PWMGroup_t *servoGroup = NULL;	/**< Group committing all servo channels at once */
+static uint32_t servoTick = 20000000;	/**< Update period in nano seconds */
+static int servoCpu = -1;		/**< CPU the slew thread is pinned to, -1 for any */
+static volatile int servoRunning = 0;	/**< Cleared to stop the slew thread */
+static pthread_t servoThread;		/**< Slew thread */
+
+/**
+ * It takes a PWM channel and the calibration of the servo on it and adds the servo.
+ * The calibration is compiled into a table of pulse widths per degree, so turning an angle
+ * into a pulse is a lookup and an integer interpolation. Servos have to be added before
+ * pwmServoStart().
+ * @param channel a constant uint8_t argument.
+ * @param period_ns a constant uint32_t argument, frame period, usually 20000000.
+ * @param minPulse_ns a constant uint32_t argument, pulse at minDeg in nano seconds.
+ * @param maxPulse_ns a constant uint32_t argument, pulse at maxDeg in nano seconds.
+ * @param minDeg a constant integer argument, lowest angle in degrees.
+ * @param maxDeg a constant integer argument, highest angle in degrees, at most 360 above minDeg.
+ * @return servo number on success and -1 if it fails.
+ */
+
+int pwmServoAdd(const uint8_t channel, const uint32_t period_ns, const uint32_t minPulse_ns,
+	const uint32_t maxPulse_ns, const int minDeg, const int maxDeg)
+{
+	PWMServo_t *servo;
+	int64_t span;
+	int i, range;
+
+	range = maxDeg - minDeg;
+	if (servoRunning || (servoCount >= MAX_SERVOS) || (range <= 0) || (range >= SERVO_LUT_SIZE) ||
+	    (minPulse_ns == 0) || (maxPulse_ns == 0) || (minPulse_ns > period_ns) || (maxPulse_ns > period_ns))
+		return -1;
+
+	for (i = 0; i < servoCount; i++)
+		if (servos[i].channel == channel)
+			return -1;
+
+	servo = &servos[servoCount];
+	servo->channel = channel;
+	servo->period = period_ns;
+	servo->minAngle = minDeg * 1000;
+	servo->maxAngle = maxDeg * 1000;
+
+	/* Rounded to the nearest nano second, the last entry is maxPulse_ns exactly */
+	span = (int64_t) maxPulse_ns - minPulse_ns;
+	for (i = 0; i <= range; i++)
+		servo->lut[i] = minPulse_ns + (span * i + (span >= 0 ? range : -range) / 2) / range;
+
+	servo->target = SERVO_NO_TARGET;
+	servo->slew = 0;
+	servo->position = servo->minAngle;
+	servo->pulse = 0;
+	return servoCount++;
+}
+
+/**
+ * This function looks up the pulse width of an angle, interpolating between whole degrees.
+ * @param servo a constant PWMServo_t pointer argument.
+ * @param angle a constant int32_t argument, milli degrees inside the range of the servo.
+ * @return pulse width in nano seconds.
+ */
+
+static uint32_t servoPulse(const PWMServo_t *servo, const int32_t angle)
+{
+	int32_t offset = angle - servo->minAngle;
+	int32_t index = offset / 1000;
+	int32_t frac = offset % 1000;
+
+	if (frac == 0)
+		return servo->lut[index];
+
+	return servo->lut[index] + ((int64_t) servo->lut[index + 1] - servo->lut[index]) * frac / 1000;
+}
+
+/**
+ * This is the slew thread. On every tick it moves each servo towards its target by at most
+ * its slew rate allows, and commits the new pulses of all servos as one PWM group.
+ * @param arg a void pointer argument, unused.
+ * @return NULL
+ */
+
+static void *servoSlewThread(void *arg)
+{
+	PWMServo_t *servo;
+	struct timespec ts;
+	uint64_t next;
+	int32_t target, slew, step, position;
+	uint32_t pulse;
+	int i, staged;
+
+	gpioRealtimeThread(servoCpu);
+	next = gpioClockNs(CLOCK_MONOTONIC);
+
+	while (servoRunning) {
+		staged = 0;
+
+		for (i = 0; i < servoCount; i++) {
+			servo = &servos[i];
+			target = __atomic_load_n(&servo->target, __ATOMIC_RELAXED);
+			if (target == SERVO_NO_TARGET)
+				continue;
+
+			/* The servo position is not known before the first target, so it is taken directly */
+			if (servo->pulse == 0) {
+				pulse = servoPulse(servo, target);
+				if (pwmConfigure(servo->channel, servo->period, pulse, 0, 1) == 0) {
+					servo->pulse = pulse;
+					__atomic_store_n(&servo->position, target, __ATOMIC_RELAXED);
+				}
+				continue;
+			}
+
+			slew = __atomic_load_n(&servo->slew, __ATOMIC_RELAXED);
+			position = servo->position;
+			step = ((int64_t) slew * servoTick) / 1000000000LL;
+			if (step == 0)
+				step = 1;
+			if ((slew == 0) || ((target <= position + step) && (target >= position - step)))
+				position = target;
+			else if (target > position)
+				position += step;
+			else
+				position -= step;
+			__atomic_store_n(&servo->position, position, __ATOMIC_RELAXED);
+
+			pulse = servoPulse(servo, position);
+			if (pulse != servo->pulse) {
+				pwmGroupSet(servoGroup, i, servo->period, pulse);
+				servo->pulse = pulse;
+				staged = 1;
+			}
+		}
+
+		if (staged)
+			pwmGroupCommit(servoGroup);
+
+		next += servoTick;
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+
+	return NULL;
+}
+
+/**
+ * It starts the slew thread for the added servos. A servo channel is started with normal polarity
+ * on its first target and not driven before. No other call should change the servo channels until
+ * pwmServoStop(); other channels can be used, pwm.c serializes the calls.
+ * @param tick_us a constant uint32_t argument, update period in micro seconds, usually the frame period.
+ * @param cpu a constant integer argument, CPU to pin the slew thread to or -1 for any.
+ * @see pwmServoSetTarget()
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmServoStart(const uint32_t tick_us, const int cpu)
+{
+	uint8_t channels[MAX_SERVOS];
+	int i;
+
+	if (servoRunning || (servoCount == 0) || (tick_us == 0) || (tick_us > 1000000))
+		return -1;
+
+	for (i = 0; i < servoCount; i++)
+		channels[i] = servos[i].channel;
+
+	servoGroup = pwmGroupCreate(channels, servoCount);
+	if (servoGroup == NULL)
+		return -1;
+
+	servoTick = tick_us * 1000;
+	servoCpu = cpu;
+
+	servoRunning = 1;
+	if (pthread_create(&servoThread, NULL, servoSlewThread, NULL) != 0) {
+		servoRunning = 0;
+		pwmGroupFree(servoGroup);
+		servoGroup = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * It takes a servo number and an angle and makes the angle the target of the servo.
+ * It returns at once; the slew thread moves the servo there on its next ticks.
+ * Angles outside the calibrated range are clamped to it.
+ * @param servo a constant integer argument.
+ * @param angle a constant int32_t argument, milli degrees.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmServoSetTarget(const int servo, const int32_t angle)
+{
+	int32_t target = angle;
+
+	if ((servo < 0) || (servo >= servoCount))
+		return -1;
+
+	if (target < servos[servo].minAngle)
+		target = servos[servo].minAngle;
+	if (target > servos[servo].maxAngle)
+		target = servos[servo].maxAngle;
+
+	__atomic_store_n(&servos[servo].target, target, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/**
+ * It takes a servo number and a maximum speed and limits how fast the servo moves to its targets.
+ * @param servo a constant integer argument.
+ * @param rate a constant int32_t argument, milli degrees per second, 0 to move in one tick.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmServoSetSlew(const int servo, const int32_t rate)
+{
+	if ((servo < 0) || (servo >= servoCount) || (rate < 0))
+		return -1;
+
+	__atomic_store_n(&servos[servo].slew, rate, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/**
+ * It takes a servo number and returns the angle commanded on the last tick.
+ * @param servo a constant integer argument.
+ * @param angle an int32_t pointer argument, set to the angle in milli degrees.
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmServoPosition(const int servo, int32_t *angle)
+{
+	if ((servo < 0) || (servo >= servoCount) || (angle == NULL))
+		return -1;
+
+	*angle = __atomic_load_n(&servos[servo].position, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/**
+ * For stopping the slew thread and removing all servos. The channels keep their last pulse.
+ */
+
+void pwmServoStop(void)
+{
+	if (servoRunning) {
+		servoRunning = 0;
+		pthread_join(servoThread, NULL);
+		pwmGroupFree(servoGroup);
+		servoGroup = NULL;
+	}
+
+	servoCount = 0;
+}
@@ -0,0 +1,249 @@
+/**********************************************************
+  PWM duty cycle streaming code applying buffers of duty
+    values at a fixed update rate
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file pwm_stream.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief PWM duty cycle streaming code applying buffers of duty values at a fixed update rate
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+/**
+ * typedef struct PWMStreamBuffer_t for one buffer of duty values.
+ */
+
+typedef struct {
+	int count;				/**< Number of duty values */
+	uint32_t duty[PWM_STREAM_SIZE];		/**< Duty values in nano seconds */
+} PWMStreamBuffer_t;
+
+static PWMStreamBuffer_t buffers[2];	/**< Playing and queued buffer */
+static unsigned int streamHead = 0;	/**< Number of buffers queued by pwmStreamQueue() */
+static unsigned int streamTail = 0;	/**< Number of buffers finished by the stream thread */
+static unsigned int streamUnderruns = 0;	/**< Updates with no duty value available */
+static unsigned int streamLate = 0;	/**< Updates that missed their tick */
+static unsigned int streamErrors = 0;	/**< Updates pwmConfigure() failed to apply */
+static uint8_t streamChannel;		/**< Channel being streamed */
+static uint32_t streamPeriod;		/**< Period of the channel in nano seconds */
+static uint8_t streamPolarity;		/**< Polarity of the channel */
+static int streamCpu = -1;		/**< CPU the stream thread is pinned to, -1 for any */
+static int fdTimer = -1;		/**< timerfd ticking at the update rate */
+static volatile int streamRunning = 0;	/**< Cleared to stop the stream thread */
+static pthread_t streamThread;		/**< Stream thread */
+
+/**
+ * This is the stream thread. It applies one duty value on every timer tick, moving on to the
+ * queued buffer when the playing one runs out. Ticks the thread was too late for are counted
+ * and their values skipped, so the waveform stays aligned to the update rate; a tick with no
+ * value left is an underrun and the last duty is held. Updates the channel refused are counted
+ * as errors.
+ * @param arg a void pointer argument, unused.
+ * @return NULL
+ */
+
+static void *pwmStreamThread(void *arg)
+{
+	const PWMStreamBuffer_t *buf;
+	uint64_t expirations;
+	unsigned int tail = streamTail;
+	uint32_t duty = 0;
+	int pos = 0, pending;
+
+	gpioRealtimeThread(streamCpu);
+
+	while (streamRunning) {
+		if (read(fdTimer, &expirations, sizeof(expirations)) != sizeof(expirations))
+			continue;
+
+		/* Skip the values of the ticks already missed */
+		if (expirations > 1)
+			streamLate += expirations - 1;
+
+		pending = 0;
+		while (expirations > 0) {
+			if (tail == __atomic_load_n(&streamHead, __ATOMIC_ACQUIRE)) {
+				/* The last value taken is still the newest one, it is applied and held */
+				if (pending && pwmConfigure(streamChannel, streamPeriod, duty, streamPolarity, 1))
+					streamErrors++;
+				streamUnderruns += expirations;
+				break;
+			}
+
+			buf = &buffers[tail & 1];
+			duty = buf->duty[pos];
+			pending = 1;
+			if (--expirations == 0) {
+				if (pwmConfigure(streamChannel, streamPeriod, duty, streamPolarity, 1))
+					streamErrors++;
+				pending = 0;
+			}
+
+			if (++pos >= buf->count) {
+				pos = 0;
+				__atomic_store_n(&streamTail, ++tail, __ATOMIC_RELEASE);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * It takes a channel, an update rate and a CPU and starts streaming duty values to the channel.
+ * The channel keeps its period and polarity, and is configured through pwmConfigure(), so it
+ * works on both PWM_BACKEND_SYSFS and PWM_BACKEND_MMAP channels. No other call should change the
+ * channel while it streams; other channels can be used, pwm.c serializes the calls.
+ * @param channel a constant uint8_t argument.
+ * @param rate_hz a constant uint32_t argument, duty values applied per second.
+ * @param cpu a constant integer argument, CPU to pin the stream thread to or -1 for any.
+ * @see pwmStreamQueue()
+ * @return 0 on success and -1 if it fails.
+ */
+
+int pwmStreamStart(const uint8_t channel, const uint32_t rate_hz, const int cpu)
+{
+	struct itimerspec its;
+	uint64_t interval;
+	int period, polarity;
+
+	if (streamRunning || (rate_hz == 0) || (rate_hz > 1000000000))
+		return -1;
+
+	period = pwmGetPeriod(channel);
+	polarity = pwmGetPolarity(channel);
+	if ((period <= 0) || (polarity < 0))
+		return -1;
+
+	fdTimer = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (fdTimer < 0)
+		return -1;
+
+	interval = 1000000000ULL / rate_hz;
+	its.it_interval.tv_sec = interval / 1000000000ULL;
+	its.it_interval.tv_nsec = interval % 1000000000ULL;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(fdTimer, 0, &its, NULL) < 0) {
+		close(fdTimer);
+		fdTimer = -1;
+		return -1;
+	}
+
+	streamChannel = channel;
+	streamPeriod = period;
+	streamPolarity = polarity;
+	streamCpu = cpu;
+	streamHead = streamTail = 0;
+	streamUnderruns = streamLate = streamErrors = 0;
+	mlock(buffers, sizeof(buffers));
+
+	streamRunning = 1;
+	if (pthread_create(&streamThread, NULL, pwmStreamThread, NULL) != 0) {
+		streamRunning = 0;
+		close(fdTimer);
+		fdTimer = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * It takes an array of duty values and queues it after the buffer being played. One buffer
+ * plays while the next one waits, so a new buffer can be queued as soon as the previous one
+ * starts playing. Duty values longer than the period are cut to the period.
+ * @param duty_ns a constant uint32_t array argument, duty values in nano seconds.
+ * @param count a constant integer argument, at most PWM_STREAM_SIZE.
+ * @return 0 on success, 1 if both buffers are in use and -1 if it fails.
+ */
+
+int pwmStreamQueue(const uint32_t duty_ns[], const int count)
+{
+	PWMStreamBuffer_t *buf;
+	unsigned int head = streamHead;
+	int i;
+
+	if (!streamRunning || (count <= 0) || (count > PWM_STREAM_SIZE))
+		return -1;
+
+	if (head - __atomic_load_n(&streamTail, __ATOMIC_ACQUIRE) >= 2)
+		return 1;
+
+	buf = &buffers[head & 1];
+	for (i = 0; i < count; i++)
+		buf->duty[i] = (duty_ns[i] > streamPeriod) ? streamPeriod : duty_ns[i];
+	buf->count = count;
+
+	__atomic_store_n(&streamHead, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * It returns the number of buffers queued and not finished yet.
+ * @return 0, 1 or 2.
+ */
+
+int pwmStreamPending(void)
+{
+	return streamHead - __atomic_load_n(&streamTail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * It returns the number of updates with no duty value queued, where the last duty was held.
+ * @return number of underruns.
+ */
+
+unsigned int pwmStreamUnderruns(void)
+{
+	return streamUnderruns;
+}
+
+/**
+ * It returns the number of updates the stream thread woke up too late for.
+ * @return number of late updates.
+ */
+
+unsigned int pwmStreamLate(void)
+{
+	return streamLate;
+}
+
+/**
+ * It returns the number of updates the channel did not accept, such as failed attribute writes.
+ * @return number of failed updates.
+ */
+
+unsigned int pwmStreamErrors(void)
+{
+	return streamErrors;
+}
+
+/**
+ * For stopping the stream thread. The channel keeps the last duty applied.
+ */
+
+void pwmStreamStop(void)
+{
+	if (!streamRunning)
+		return;
+
+	streamRunning = 0;
+	pthread_join(streamThread, NULL);
+	close(fdTimer);
+	fdTimer = -1;
+	munlock(buffers, sizeof(buffers));
+}
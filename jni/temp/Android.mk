@@ -4,7 +4,7 @@ LOCAL_LDLIBS := -llog
 LOCAL_MODULE := BBBAndroidHAL
 LOCAL_C_INCLUDES += $(LIBUSB_ROOT_ABS)
 LOCAL_SHARED_LIBRARIES += libusb1.0
-LOCAL_SRC_FILES := jni_wrapper.c gpio.c adc.c pwm.c i2c.c spi.c can.c uart.c usb.c
+LOCAL_SRC_FILES := jni_wrapper.c gpio.c gpio_event.c gpio_capture.c gpio_waveform.c gpio_pinmux.c gpio_counter.c gpio_encoder.c gpio_softspi.c gpio_onewire.c gpio_parallel.c gpio_stepper.c gpio_softpwm.c gpio_keypad.c gpio_arbiter.c adc.c pwm.c pwm_stream.c pwm_servo.c i2c.c spi.c can.c uart.c usb.c
 include $(BUILD_SHARED_LIBRARY)
 
 include include/libusb/android/jni/libusb.mk
\ No newline at end of file
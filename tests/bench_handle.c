@@ -0,0 +1,97 @@
+/**********************************************************
+  Host microbenchmark of GPIO pin handles against the
+    header/pin functions on a memfd register file
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file bench_handle.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Host microbenchmark of GPIO pin handles against the header/pin functions on a memfd register file
+ */
+
+#include "test_common.h"
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define BENCH_LOOPS  10000000	/**< Accesses timed for each method */
+#define GPIO1_BASE   0x4804C000	/**< Bank of P8_11 */
+#define P8_11_MASK   (1u << 13)	/**< GPIO1[13] */
+
+/**
+ * This function prints the time per access of a method.
+ * @param name a constant char pointer argument.
+ * @param ns a constant uint64_t argument, time of all BENCH_LOOPS accesses.
+ */
+
+static void report(const char *name, const uint64_t ns)
+{
+  printf("bench_handle: %-22s %6.2f ns per access\n", name, (double) ns / BENCH_LOOPS);
+}
+
+int main(void)
+{
+  volatile uint32_t *regs;
+  GPIOPin_t *handle;
+  uint64_t start, elapsed;
+  unsigned int sum = 0;
+  int i;
+
+  if (testRegisterFile() || ((regs = testRegisters(GPIO1_BASE)) == NULL)) {
+    printf("bench_handle: cannot create the register file\n");
+    return 1;
+  }
+
+  regs[GPIO_OE_REG/4] = 0xFFFFFFFF;
+  regs[GPIO_DATA_IN_REG/4] = P8_11_MASK;
+  CHECK(openGPIO(GPIO_ACCESS_MMAP) == 0);
+
+  handle = gpioAcquire(8, 11, GPIO_DIRECTION_OUTPUT);
+  CHECK(handle != NULL);
+  if (handle == NULL)
+    return testResult("bench_handle");
+  CHECK(!(regs[GPIO_OE_REG/4] & P8_11_MASK));
+
+  /* The handle reaches the same registers as the header/pin functions */
+  CHECK(gpioPinWrite(handle, 1) == 0);
+  CHECK(regs[GPIO_SETDATAOUT_REG/4] == P8_11_MASK);
+  CHECK(gpioPinToggle(handle) == 0);
+  CHECK(regs[GPIO_CLEARDATAOUT_REG/4] == P8_11_MASK);
+  CHECK(gpioPinRead(handle) == 1);
+  CHECK(readGPIO(8, 11) != 0);
+
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  for (i = 0; i < BENCH_LOOPS; i++)
+    writeGPIO(8, 11, i & 1);
+  report("writeGPIO()", gpioClockNs(CLOCK_MONOTONIC) - start);
+
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  for (i = 0; i < BENCH_LOOPS; i++)
+    gpioPinWrite(handle, i & 1);
+  report("gpioPinWrite()", gpioClockNs(CLOCK_MONOTONIC) - start);
+
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  for (i = 0; i < BENCH_LOOPS; i++)
+    gpioPinToggle(handle);
+  report("gpioPinToggle()", gpioClockNs(CLOCK_MONOTONIC) - start);
+
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  for (i = 0; i < BENCH_LOOPS; i++)
+    sum += readGPIO(8, 11) != 0;
+  report("readGPIO()", gpioClockNs(CLOCK_MONOTONIC) - start);
+
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  for (i = 0; i < BENCH_LOOPS; i++)
+    sum += gpioPinRead(handle);
+  elapsed = gpioClockNs(CLOCK_MONOTONIC) - start;
+  report("gpioPinRead()", elapsed);
+
+  CHECK(sum == 2 * BENCH_LOOPS);
+
+  gpioRelease(handle);
+  closeGPIO();
+  return testResult("bench_handle");
+}
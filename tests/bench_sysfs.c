@@ -0,0 +1,149 @@
+/**********************************************************
+  Host benchmark of the sysfs GPIO access against a fake
+    /sys/class/gpio tree in a temporary directory
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file bench_sysfs.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Host benchmark of the sysfs GPIO access against a fake /sys/class/gpio tree in a temporary directory
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "test_common.h"
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define BENCH_LOOPS  200000	/**< Accesses timed for each method */
+#define BENCH_ID     45		/**< GPIO id of P8_11 */
+
+/**
+ * This function writes a value the way the HAL did before caching, with a path lookup per access.
+ * @param value a constant unsigned int argument.
+ * @return 0 on success and 1 if it fails.
+ */
+
+static int writeUncached(const unsigned int value)
+{
+  char path[64];
+  int fd, len;
+
+  snprintf(path, sizeof(path), SYSFS_GPIO_DIR "/gpio%d/value", BENCH_ID);
+  fd = open(path, O_WRONLY);
+  if (fd < 0)
+    return 1;
+  len = write(fd, value ? "1" : "0", 1);
+  close(fd);
+
+  return (len == 1) ? 0 : 1;
+}
+
+/**
+ * This function reads a value the way the HAL did before caching, with a path lookup per access.
+ * @return value read.
+ */
+
+static int readUncached(void)
+{
+  char path[64], ch = '0';
+  int fd;
+
+  snprintf(path, sizeof(path), SYSFS_GPIO_DIR "/gpio%d/value", BENCH_ID);
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  if (read(fd, &ch, 1) != 1)
+    ch = '0';
+  close(fd);
+
+  return ch != '0';
+}
+
+/**
+ * This function creates a fake GPIO directory holding a value and a direction file.
+ * @param id a constant integer argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int fakePin(const int id)
+{
+  char path[64];
+  FILE *fd;
+
+  snprintf(path, sizeof(path), SYSFS_GPIO_DIR "/gpio%d", id);
+  if (mkdir(path, 0755) < 0)
+    return -1;
+
+  snprintf(path, sizeof(path), SYSFS_GPIO_DIR "/gpio%d/value", id);
+  fd = fopen(path, "w");
+  if (fd == NULL)
+    return -1;
+  fputs("0", fd);
+  fclose(fd);
+
+  snprintf(path, sizeof(path), SYSFS_GPIO_DIR "/gpio%d/direction", id);
+  fd = fopen(path, "w");
+  if (fd == NULL)
+    return -1;
+  fputs("in", fd);
+  fclose(fd);
+
+  return 0;
+}
+
+int main(void)
+{
+  char dir[] = "/tmp/bbbtest_sysfs_XXXXXX";
+  char cmd[64];
+  uint64_t start, uncached, cached;
+  int i, sum = 0;
+
+  /* SYSFS_GPIO_DIR is relative in the host build, so the fake tree lives in a temporary directory */
+  if ((mkdtemp(dir) == NULL) || (chdir(dir) < 0) || (mkdir("sys", 0755) < 0) ||
+      (mkdir("sys/class", 0755) < 0) || (mkdir(SYSFS_GPIO_DIR, 0755) < 0) || fakePin(BENCH_ID)) {
+    printf("bench_sysfs: cannot create the fake sysfs tree\n");
+    return 1;
+  }
+
+  CHECK(openGPIO(GPIO_ACCESS_SYSFS) == 0);
+  CHECK(gpioSetDirection(8, 11, GPIO_DIRECTION_OUTPUT) == 0);
+  CHECK(writeGPIO(8, 11, 1) == 0);
+  CHECK(readGPIO(8, 11) == 1);
+  CHECK(readUncached() == 1);
+  CHECK(writeGPIO(8, 11, 0) == 0);
+  CHECK(readUncached() == 0);
+
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  for (i = 0; i < BENCH_LOOPS; i++) {
+    writeUncached(i & 1);
+    sum += readUncached();
+  }
+  uncached = gpioClockNs(CLOCK_MONOTONIC) - start;
+
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  for (i = 0; i < BENCH_LOOPS; i++) {
+    writeGPIO(8, 11, i & 1);
+    sum += readGPIO(8, 11);
+  }
+  cached = gpioClockNs(CLOCK_MONOTONIC) - start;
+
+  CHECK(sum == BENCH_LOOPS);
+  closeGPIO();
+
+  printf("bench_sysfs: open/read/close %llu ns per write and read, cached descriptor %llu ns, %.1fx faster\n",
+    (unsigned long long) (uncached / BENCH_LOOPS), (unsigned long long) (cached / BENCH_LOOPS),
+    cached ? (double) uncached / cached : 0.0);
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  if (system(cmd) != 0)
+    printf("bench_sysfs: cannot remove %s\n", dir);
+
+  return testResult("bench_sysfs");
+}
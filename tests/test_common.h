@@ -0,0 +1,84 @@
+/**********************************************************
+  Helpers shared by the host tests and benchmarks
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file test_common.h
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Helpers shared by the host tests and benchmarks
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef __TEST_COMMON_H__
+#define __TEST_COMMON_H__
+
+#ifndef TEST_MEM_FD
+#define TEST_MEM_FD     100		/**< File descriptor of the register file, the Makefile maps GPIO_MEM_DEV to it */
+#endif
+#define TEST_MEM_SIZE   0x48400000	/**< Size of the register file, covers the control module, the GPIO banks and the PWMSS modules */
+
+static int testFailures = 0;	/**< Number of failed checks */
+
+/** Counts and reports a failed check without stopping the test */
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    testFailures++; \
+  } \
+} while (0)
+
+/**
+ * It creates a sparse memfd standing in for /dev/mem and puts it on TEST_MEM_FD,
+ * so the HAL opens it through /proc/self/fd. Registers read back what was last written.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static inline int testRegisterFile(void)
+{
+  int fd;
+
+  fd = syscall(__NR_memfd_create, "bbbtest_mem", 0);
+  if ((fd < 0) || (ftruncate(fd, TEST_MEM_SIZE) < 0))
+    return -1;
+
+  if ((fd != TEST_MEM_FD) && ((dup2(fd, TEST_MEM_FD) < 0) || (close(fd) < 0)))
+    return -1;
+
+  return 0;
+}
+
+/**
+ * It maps the register page at a physical address of the register file.
+ * @param base a constant uint32_t argument, page aligned address.
+ * @return pointer to the registers or NULL if it fails.
+ */
+
+static inline volatile uint32_t *testRegisters(const uint32_t base)
+{
+  void *map = mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE, MAP_SHARED, TEST_MEM_FD, base);
+
+  return (map == MAP_FAILED) ? NULL : (volatile uint32_t *) map;
+}
+
+/**
+ * It prints the result of a test program.
+ * @param name a constant char pointer argument.
+ * @return exit status of the test program.
+ */
+
+static inline int testResult(const char *name)
+{
+  printf("%s: %s (%d failed checks)\n", name, testFailures ? "FAIL" : "PASS", testFailures);
+  return testFailures ? 1 : 0;
+}
+
+#endif /* __TEST_COMMON_H__ */
@@ -0,0 +1,92 @@
+/**********************************************************
+  Host test of the GPIO edge counter against a fake sysfs
+    tree whose value file is a FIFO
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file test_counter.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Host test of the GPIO edge counter against a fake sysfs tree whose value file is a FIFO
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "test_common.h"
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+static int fdValue = -1;	/**< Write end of the FIFO standing in for the value file of P8_11 */
+
+/**
+ * This function sends one level to the fake value file and gives the sampler time to take it.
+ * @param level a constant char pointer argument.
+ */
+
+static void sendLevel(const char *level)
+{
+  struct timespec ts = { 0, 20000000 };
+
+  CHECK(write(fdValue, level, 1) == 1);
+  nanosleep(&ts, NULL);
+}
+
+int main(void)
+{
+  char dir[] = "/tmp/bbbtest_counter_XXXXXX";
+  char cmd[64], edge[16];
+  GPIOCount_t count;
+  FILE *fd;
+
+  /* P8_11 is gpio45 and has a value file, P8_12 is not exported */
+  if ((mkdtemp(dir) == NULL) || (chdir(dir) < 0) || (mkdir("sys", 0755) < 0) ||
+      (mkdir("sys/class", 0755) < 0) || (mkdir(SYSFS_GPIO_DIR, 0755) < 0) ||
+      (mkdir(SYSFS_GPIO_DIR "/gpio45", 0755) < 0) ||
+      (mkfifo(SYSFS_GPIO_DIR "/gpio45/value", 0644) < 0) ||
+      ((fdValue = open(SYSFS_GPIO_DIR "/gpio45/value", O_RDWR | O_NONBLOCK)) < 0)) {
+    printf("test_counter: cannot create the fake sysfs tree\n");
+    return 1;
+  }
+
+  /* Without edge events the counter polls, which needs memory map access */
+  CHECK(gpioCounterAdd(8, 12) == 0);
+  CHECK(gpioCounterStart(-1, 100) == -1);
+  gpioCounterStop();
+
+  /* Edge events are used when the pin has them, the level at start is not an edge */
+  CHECK(gpioCounterAdd(8, 11) == 0);
+  CHECK(write(fdValue, "0", 1) == 1);
+  CHECK(gpioCounterStart(-1, 100) == 0);
+  fd = fopen(SYSFS_GPIO_DIR "/gpio45/edge", "r");
+  CHECK((fd != NULL) && (fgets(edge, sizeof(edge), fd) != NULL) && (strcmp(edge, "both") == 0));
+  if (fd != NULL)
+    fclose(fd);
+
+  sendLevel("1");
+  sendLevel("0");
+  sendLevel("1");
+  CHECK(gpioCounterRead(8, 11, &count) == 0);
+  CHECK((count.edges == 3) && (count.rising == 2));
+  CHECK((count.period_ns >= 30000000) && (count.high_ns >= 10000000));
+  CHECK(gpioCounterFrequency(8, 11) > 0);
+
+  /* An event reading the level seen last is a missed pulse, counted as two edges */
+  sendLevel("1");
+  CHECK(gpioCounterRead(8, 11, &count) == 0);
+  CHECK((count.edges == 5) && (count.rising == 3));
+  CHECK(gpioCounterRead(8, 12, &count) == -1);
+
+  gpioCounterStop();
+  close(fdValue);
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  if (system(cmd) != 0)
+    printf("test_counter: cannot remove %s\n", dir);
+
+  return testResult("test_counter");
+}
@@ -0,0 +1,180 @@
+/**********************************************************
+  Host test of the EHRPWM register backend against a
+    memfd register file and a fake /sys/class/pwm tree
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file test_ehrpwm.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Host test of the EHRPWM register backend against a memfd register file and a fake /sys/class/pwm tree
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "test_common.h"
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define PWMSS0_BASE     0x48300000	/**< PWMSS module of channels 0 and 1 */
+#define UPDATE_LOOPS    1000000		/**< Duty updates timed */
+
+/* EHRPWM registers as indices of uint16_t, as in pwm.c */
+#define TBCTL    0x00	/**< Time base control */
+#define TBPRD    0x05	/**< Time base period */
+#define CMPA     0x09	/**< Compare A */
+#define CMPB     0x0A	/**< Compare B */
+#define AQCTLA   0x0B	/**< Action qualifier of output A */
+#define AQCSFRC  0x0E	/**< Continuous software force */
+
+/**
+ * This function writes an attribute file of the fake PWM tree.
+ * @param channel a constant integer argument.
+ * @param attr a constant char pointer argument.
+ * @param value a constant char pointer argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int fakeAttr(const int channel, const char *attr, const char *value)
+{
+  char path[64];
+  FILE *fd;
+
+  snprintf(path, sizeof(path), SYSFS_PWM_DIR "/pwm%d/%s", channel, attr);
+  fd = fopen(path, "w");
+  if (fd == NULL)
+    return -1;
+  fputs(value, fd);
+  fclose(fd);
+
+  return 0;
+}
+
+/**
+ * This function creates a fake channel directory, stopped and with the given period.
+ * @param channel a constant integer argument.
+ * @param period a constant char pointer argument.
+ * @return 0 on success and -1 if it fails.
+ */
+
+static int fakeChannel(const int channel, const char *period)
+{
+  char path[64];
+
+  snprintf(path, sizeof(path), SYSFS_PWM_DIR "/pwm%d", channel);
+  if ((mkdir(path, 0755) < 0) || fakeAttr(channel, "period_ns", period) ||
+      fakeAttr(channel, "duty_ns", "0") || fakeAttr(channel, "polarity", "0") ||
+      fakeAttr(channel, "run", "0"))
+    return -1;
+
+  return 0;
+}
+
+int main(void)
+{
+  char dir[] = "/tmp/bbbtest_pwm_XXXXXX";
+  char cmd[64];
+  volatile uint32_t *pwmss;
+  volatile uint16_t *regs;
+  uint64_t start, elapsed;
+  int i;
+
+  /* SYSFS_PWM_DIR is relative in the host build, so the fake tree lives in a temporary directory */
+  if (testRegisterFile() || ((pwmss = testRegisters(PWMSS0_BASE)) == NULL) ||
+      (mkdtemp(dir) == NULL) || (chdir(dir) < 0) || (mkdir("sys", 0755) < 0) ||
+      (mkdir("sys/class", 0755) < 0) || (mkdir(SYSFS_PWM_DIR, 0755) < 0) ||
+      fakeChannel(0, "20000000") || fakeChannel(1, "1000000") || fakeChannel(2, "1000000")) {
+    printf("test_ehrpwm: cannot create the register file or the fake sysfs tree\n");
+    return 1;
+  }
+  regs = (volatile uint16_t *) ((volatile uint8_t *) pwmss + 0x200);
+
+  /* A module whose clock the kernel did not start is refused, the channel stays stopped */
+  CHECK(pwmSetBackend(0, PWM_BACKEND_MMAP) == -1);
+  CHECK(pwmRunCheck(0) == 0);
+  pwmss[0x0C/4] = 1 << 8;
+
+  /* The channel keeps its period and stays stopped, forced low */
+  CHECK(pwmSetBackend(0, PWM_BACKEND_MMAP) == 0);
+  CHECK(((regs[TBCTL] >> 10) & 7) == 5);
+  CHECK(regs[TBPRD] == 62499);
+  CHECK(regs[CMPA] == 0);
+  CHECK(regs[AQCTLA] == 0x0012);
+  CHECK((regs[AQCSFRC] & 3) == 1);
+  CHECK(pwmGetPeriod(0) == 20000000);
+  CHECK(pwmRunCheck(0) == 0);
+
+  /* Duty and run are register stores, TBPRD is left alone */
+  CHECK(pwmConfigure(0, 20000000, 1500000, 0, 1) == 0);
+  CHECK(regs[CMPA] == 4687);
+  CHECK((regs[AQCSFRC] & 3) == 0);
+  CHECK(regs[TBPRD] == 62499);
+  CHECK(pwmGetDutyCycle(0) == 1500000);
+  CHECK(pwmRunCheck(0) == 1);
+  CHECK(pwmConfigure(0, 20000000, 30000000, 0, 1) == -1);
+
+  /* The other output of the module takes over the shared period */
+  CHECK(pwmSetBackend(1, PWM_BACKEND_MMAP) == 0);
+  CHECK(pwmGetPeriod(1) == 20000000);
+  CHECK(pwmConfigure(1, 20000000, 10000000, 0, 1) == 0);
+  CHECK(regs[CMPB] == 31250);
+  CHECK(regs[TBPRD] == 62499);
+
+  /* A period shorter than the duty of the other output is refused, nothing changes */
+  CHECK(pwmConfigure(0, 1000000, 250000, 0, 1) == -1);
+  CHECK(((regs[TBCTL] >> 10) & 7) == 5);
+  CHECK(regs[TBPRD] == 62499);
+  CHECK(regs[CMPB] == 31250);
+  CHECK(pwmGetDutyCycle(1) == 10000000);
+
+  /* A new period changes the prescaler and rescales both compare values */
+  CHECK(pwmConfigure(1, 20000000, 500000, 0, 1) == 0);
+  CHECK(pwmConfigure(0, 1000000, 250000, 0, 1) == 0);
+  CHECK(((regs[TBCTL] >> 10) & 7) == 1);
+  CHECK(regs[TBPRD] == 49999);
+  CHECK(regs[CMPA] == 12500);
+  CHECK(regs[CMPB] == 25000);
+  CHECK(pwmGetPeriod(1) == 1000000);
+  CHECK(pwmSetDutyCycle(1, 750000) == 0);
+  CHECK(regs[CMPB] == 37500);
+
+  /* Periods past the slowest time base are refused */
+  CHECK(pwmConfigure(0, 100000000, 0, 0, 1) == -1);
+  CHECK(regs[TBPRD] == 49999);
+
+  /* Inverted polarity swaps the actions, stopping forces the inactive level high */
+  CHECK(pwmSetPolarity(0, 1) == 0);
+  CHECK(regs[AQCTLA] == 0x0021);
+  CHECK(pwmStop(0) == 0);
+  CHECK((regs[AQCSFRC] & 3) == 2);
+  CHECK(pwmRun(0) == 0);
+  CHECK((regs[AQCSFRC] & 3) == 0);
+
+  /* The eCAP channels have no EHRPWM registers */
+  CHECK(pwmSetBackend(2, PWM_BACKEND_MMAP) == -1);
+
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  for (i = 0; i < UPDATE_LOOPS; i++)
+    pwmSetDutyCycle(0, (i & 1) ? 250000 : 750000);
+  elapsed = gpioClockNs(CLOCK_MONOTONIC) - start;
+  CHECK(regs[CMPA] == 12500);
+  printf("test_ehrpwm: %.1f ns per memory mapped duty update\n", (double) elapsed / UPDATE_LOOPS);
+
+  /* Going back to the file system releases the software force */
+  CHECK(pwmStop(1) == 0);
+  CHECK((regs[AQCSFRC] & 0xC) == 0x4);
+  CHECK(pwmSetBackend(1, PWM_BACKEND_SYSFS) == 0);
+  CHECK((regs[AQCSFRC] & 0xC) == 0);
+
+  pwmClose();
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  if (system(cmd) != 0)
+    printf("test_ehrpwm: cannot remove %s\n", dir);
+
+  return testResult("test_ehrpwm");
+}
@@ -0,0 +1,148 @@
+/**********************************************************
+  Host test of the GPIO edge events against a fake sysfs
+    tree whose value file is a FIFO
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file test_event.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Host test of the GPIO edge events against a fake sysfs tree whose value file is a FIFO
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "test_common.h"
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define EDGE_COUNT  300	/**< Edges sent at once to overflow the event queue */
+
+static int fdValue = -1;	/**< Write end of the FIFO standing in for the value file of P8_11 */
+
+/**
+ * This function sends levels to the fake value file, one character per edge.
+ * @param levels a constant char pointer argument.
+ */
+
+static void sendLevels(const char *levels)
+{
+  CHECK(write(fdValue, levels, strlen(levels)) == (ssize_t) strlen(levels));
+}
+
+/**
+ * This is a thread that holds the level of the fake value file for the sample taken when the
+ * glitch time ends, since a FIFO only answers the reads it was written for.
+ * @param arg a void pointer argument, unused.
+ * @return NULL
+ */
+
+static void *holdThread(void *arg)
+{
+  struct timespec ts = { 0, 10000000 };
+
+  nanosleep(&ts, NULL);
+  sendLevels("0");
+  return NULL;
+}
+
+int main(void)
+{
+  char dir[] = "/tmp/bbbtest_event_XXXXXX";
+  char cmd[64], edge[16], levels[EDGE_COUNT + 1];
+  GPIOEvent_t events[EDGE_COUNT];
+  pthread_t hold;
+  uint64_t before, after;
+  FILE *fd;
+  int i, n, total;
+
+  /* P8_11 is gpio45, its value file is a FIFO the test writes levels into */
+  if ((mkdtemp(dir) == NULL) || (chdir(dir) < 0) || (mkdir("sys", 0755) < 0) ||
+      (mkdir("sys/class", 0755) < 0) || (mkdir(SYSFS_GPIO_DIR, 0755) < 0) ||
+      (mkdir(SYSFS_GPIO_DIR "/gpio45", 0755) < 0) ||
+      (mkfifo(SYSFS_GPIO_DIR "/gpio45/value", 0644) < 0) ||
+      ((fdValue = open(SYSFS_GPIO_DIR "/gpio45/value", O_RDWR | O_NONBLOCK)) < 0)) {
+    printf("test_event: cannot create the fake sysfs tree\n");
+    return 1;
+  }
+
+  CHECK(gpioSetEdge(8, 11, GPIO_EDGE_BOTH) == 0);
+  fd = fopen(SYSFS_GPIO_DIR "/gpio45/edge", "r");
+  CHECK((fd != NULL) && (fgets(edge, sizeof(edge), fd) != NULL) && (strcmp(edge, "both") == 0));
+  if (fd != NULL)
+    fclose(fd);
+  CHECK(gpioSetEdge(8, 1, GPIO_EDGE_BOTH) == -1);
+
+  /* The level at the time the pin is added is not an event */
+  sendLevels("0");
+  CHECK(gpioEventAdd(8, 11) == 0);
+  CHECK(gpioEventWait(0) == 0);
+  CHECK(gpioEventRead(events, EDGE_COUNT) == 0);
+
+  before = gpioClockNs(CLOCK_MONOTONIC);
+  sendLevels("1");
+  CHECK(gpioEventWait(100) == 1);
+  after = gpioClockNs(CLOCK_MONOTONIC);
+  n = gpioEventRead(events, EDGE_COUNT);
+  CHECK(n == 1);
+  CHECK((events[0].header == 8) && (events[0].pin == 11) && (events[0].value == 1));
+  CHECK((events[0].timestamp >= before) && (events[0].timestamp <= after));
+
+  /* Events are drained in order and in batches */
+  sendLevels("0101");
+  for (total = 0, i = 0; (total < 4) && (i < 10); i++)
+    total += gpioEventWait(100);
+  CHECK(total == 4);
+  n = gpioEventRead(events, 3);
+  CHECK(n == 3);
+  CHECK((events[0].value == 0) && (events[1].value == 1) && (events[2].value == 0));
+  CHECK((events[0].timestamp <= events[1].timestamp) && (events[1].timestamp <= events[2].timestamp));
+  n = gpioEventRead(events, EDGE_COUNT);
+  CHECK((n == 1) && (events[0].value == 1));
+
+  /* A full queue drops the newest events and counts them, the pin ends high */
+  for (i = 0; i < EDGE_COUNT; i++)
+    levels[i] = (i & 1) ? '1' : '0';
+  levels[EDGE_COUNT] = '\0';
+  sendLevels(levels);
+  while (gpioEventWait(0) > 0)
+    ;
+  n = gpioEventRead(events, EDGE_COUNT);
+  CHECK(n < EDGE_COUNT);
+  CHECK(gpioEventDropped() == (unsigned int) (EDGE_COUNT - n));
+  CHECK((events[0].value == 0) && (events[n - 1].value == ((n - 1) & 1)));
+
+  /* A pulse shorter than the glitch time is filtered out as two edges */
+  CHECK(gpioEventFilter(8, 11, 0, 5000) == 0);
+  sendLevels("01");
+  CHECK(gpioEventWait(20) == 0);
+  CHECK(gpioEventSuppressed(8, 11) == 2);
+  CHECK(gpioEventRead(events, EDGE_COUNT) == 0);
+
+  /* A level held for the glitch time is reported with the time of its edge */
+  before = gpioClockNs(CLOCK_MONOTONIC);
+  sendLevels("0");
+  CHECK(pthread_create(&hold, NULL, holdThread, NULL) == 0);
+  CHECK(gpioEventWait(100) == 1);
+  pthread_join(hold, NULL);
+  n = gpioEventRead(events, EDGE_COUNT);
+  CHECK((n == 1) && (events[0].value == 0) && (events[0].timestamp >= before));
+  CHECK(gpioClockNs(CLOCK_MONOTONIC) - events[0].timestamp >= 5000000);
+
+  CHECK(gpioEventRemove(8, 11) == 0);
+  CHECK(gpioEventRemove(8, 11) == -1);
+  gpioEventClose();
+  close(fdValue);
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  if (system(cmd) != 0)
+    printf("test_event: cannot remove %s\n", dir);
+
+  return testResult("test_event");
+}
@@ -0,0 +1,134 @@
+/**********************************************************
+  Host test of the memory map GPIO writes against a memfd
+    register file standing in for /dev/mem
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file test_mmap_write.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Host test of the memory map GPIO writes against a memfd register file standing in for /dev/mem
+ */
+
+#include <pthread.h>
+#include "test_common.h"
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define GPIO1_BASE     0x4804C000	/**< Bank of P8_11, P8_12 and P9_12 */
+#define GPIO2_BASE     0x481AC000	/**< Bank of P8_07 */
+#define P8_11_MASK     (1u << 13)	/**< GPIO1[13] */
+#define P8_12_MASK     (1u << 12)	/**< GPIO1[12] */
+#define P9_12_MASK     (1u << 28)	/**< GPIO1[28] */
+#define P8_07_MASK     (1u << 2)	/**< GPIO2[2] */
+#define DATA_OUT_MARK  0x5A5A5A5A	/**< DATA OUT content that no write may change */
+#define WRITER_LOOPS   1000000		/**< Writes of each concurrent writer */
+
+static volatile uint32_t *bank1;	/**< Registers of GPIO1 */
+static volatile int badStore = 0;	/**< Set when a writer saw a store of a foreign mask */
+
+/**
+ * This is a writer thread toggling one pin of GPIO1 while the other writer toggles another one.
+ * @param arg a void pointer argument, the pin number on P8.
+ * @return NULL
+ */
+
+static void *writerThread(void *arg)
+{
+  const unsigned int pin = (unsigned int) (uintptr_t) arg;
+  uint32_t set, clear;
+  int i;
+
+  for (i = 0; i < WRITER_LOOPS; i++) {
+    writeGPIO(8, pin, i & 1);
+
+    /* Every store holds one pin mask, never a whole DATA OUT word */
+    set = bank1[GPIO_SETDATAOUT_REG/4];
+    clear = bank1[GPIO_CLEARDATAOUT_REG/4];
+    if (((set != 0) && (set != P8_11_MASK) && (set != P8_12_MASK)) ||
+        ((clear != 0) && (clear != P8_11_MASK) && (clear != P8_12_MASK)))
+      badStore = 1;
+  }
+
+  return NULL;
+}
+
+int main(void)
+{
+  const unsigned int headers[4] = { 8, 8, 9, 8 };
+  const unsigned int pins[4] = { 11, 12, 12, 7 };
+  volatile uint32_t *bank2;
+  GPIOPlan_t *plan;
+  GPIOPin_t *handle;
+  pthread_t writer[2];
+
+  if (testRegisterFile() || ((bank1 = testRegisters(GPIO1_BASE)) == NULL) ||
+      ((bank2 = testRegisters(GPIO2_BASE)) == NULL)) {
+    printf("test_mmap_write: cannot create the register file\n");
+    return 1;
+  }
+
+  /* All pins outputs */
+  bank1[GPIO_OE_REG/4] = 0;
+  bank2[GPIO_OE_REG/4] = 0;
+  bank1[GPIO_DATA_OUT_REG/4] = DATA_OUT_MARK;
+  bank2[GPIO_DATA_OUT_REG/4] = DATA_OUT_MARK;
+  CHECK(openGPIO(GPIO_ACCESS_MMAP) == 0);
+
+  /* A single pin write is one store to SET or CLEAR DATA OUT */
+  CHECK(writeGPIO(8, 11, 1) == 0);
+  CHECK(bank1[GPIO_SETDATAOUT_REG/4] == P8_11_MASK);
+  CHECK(bank1[GPIO_CLEARDATAOUT_REG/4] == 0);
+  CHECK(writeGPIO(8, 11, 0) == 0);
+  CHECK(bank1[GPIO_CLEARDATAOUT_REG/4] == P8_11_MASK);
+  CHECK(bank1[GPIO_DATA_OUT_REG/4] == DATA_OUT_MARK);
+
+  /* A plan writes each bank with at most one SET and one CLEAR store */
+  plan = gpioPlanCreate(headers, pins, 4);
+  CHECK(plan != NULL);
+  CHECK(gpioWriteMask(plan, 0x5) == 0);
+  CHECK(bank1[GPIO_SETDATAOUT_REG/4] == (P8_11_MASK | P9_12_MASK));
+  CHECK(bank1[GPIO_CLEARDATAOUT_REG/4] == P8_12_MASK);
+  CHECK(bank2[GPIO_CLEARDATAOUT_REG/4] == P8_07_MASK);
+  CHECK(bank2[GPIO_SETDATAOUT_REG/4] == 0);
+  gpioPlanFree(plan);
+
+  /* Pins known to be inputs are refused by plans and handles as by writeGPIO() */
+  CHECK(gpioSetDirection(8, 12, GPIO_DIRECTION_INPUT) == 0);
+  bank1[GPIO_SETDATAOUT_REG/4] = 0;
+  CHECK(writeGPIO(8, 12, 1) == 1);
+  plan = gpioPlanCreate(headers, pins, 4);
+  CHECK(plan != NULL);
+  CHECK(gpioWriteMask(plan, 0xF) == 1);
+  CHECK(bank1[GPIO_SETDATAOUT_REG/4] == 0);
+  CHECK(gpioSetDirectionMask(plan, 0xF) == 0);
+  CHECK(gpioWriteMask(plan, 0xF) == 0);
+  gpioPlanFree(plan);
+  CHECK(gpioSetDirection(8, 12, GPIO_DIRECTION_INPUT) == 0);
+  handle = gpioAcquire(8, 12, GPIO_DIRECTION_KEEP);
+  CHECK(handle != NULL);
+  if (handle != NULL) {
+    bank1[GPIO_SETDATAOUT_REG/4] = 0;
+    CHECK(gpioPinWrite(handle, 1) == 1);
+    CHECK(bank1[GPIO_SETDATAOUT_REG/4] == 0);
+    gpioRelease(handle);
+  }
+  CHECK(gpioSetDirection(8, 12, GPIO_DIRECTION_OUTPUT) == 0);
+
+  /* Writers of different pins of a bank never store each other's bits */
+  bank1[GPIO_SETDATAOUT_REG/4] = 0;
+  bank1[GPIO_CLEARDATAOUT_REG/4] = 0;
+  CHECK(pthread_create(&writer[0], NULL, writerThread, (void *) (uintptr_t) 11) == 0);
+  CHECK(pthread_create(&writer[1], NULL, writerThread, (void *) (uintptr_t) 12) == 0);
+  pthread_join(writer[0], NULL);
+  pthread_join(writer[1], NULL);
+  CHECK(!badStore);
+  CHECK(bank1[GPIO_DATA_OUT_REG/4] == DATA_OUT_MARK);
+  CHECK(bank2[GPIO_DATA_OUT_REG/4] == DATA_OUT_MARK);
+
+  closeGPIO();
+  return testResult("test_mmap_write");
+}
@@ -0,0 +1,115 @@
+/**********************************************************
+  Host test of the 1-Wire bus master against an open
+    drain line simulated in a memfd register file
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file test_onewire.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Host test of the 1-Wire bus master against an open drain line simulated in a memfd register file
+ */
+
+#include "test_common.h"
+
+/* Included to reach the static helpers of the bus master */
+#include "gpio_onewire.c"
+
+#define GPIO1_BASE   0x4804C000	/**< Bank of P8_11 and P8_12 */
+#define LINE_MASK    (1u << 13)	/**< P8_11, GPIO1[13], the 1-Wire line */
+#define OTHER_MASK   (1u << 12)	/**< P8_12, GPIO1[12], an output sharing the bank */
+
+int main(void)
+{
+  volatile uint32_t *regs;
+  uint8_t scratch[9];
+  int32_t temps[4];
+  uint64_t start, elapsed;
+  int id, present, byte;
+
+  if (testRegisterFile() || ((regs = testRegisters(GPIO1_BASE)) == NULL)) {
+    printf("test_onewire: cannot create the register file\n");
+    return 1;
+  }
+
+  /* Every pin starts as an input, as after reset */
+  regs[GPIO_OE_REG/4] = 0xFFFFFFFF;
+  CHECK(openGPIO(GPIO_ACCESS_MMAP) == 0);
+
+  id = oneWireOpen(8, 11);
+  CHECK(id >= 0);
+  CHECK(regs[GPIO_OE_REG/4] & LINE_MASK);
+  CHECK(regs[GPIO_CLEARDATAOUT_REG/4] == LINE_MASK);
+
+  /* A pin of the same bank configured through gpio.c must survive the bus traffic */
+  CHECK(gpioSetDirection(8, 12, GPIO_DIRECTION_OUTPUT) == 0);
+  CHECK(!(regs[GPIO_OE_REG/4] & OTHER_MASK));
+
+  /* A device holding the line low answers the reset */
+  regs[GPIO_DATA_IN_REG/4] = 0;
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  present = oneWireReset(id);
+  elapsed = gpioClockNs(CLOCK_MONOTONIC) - start;
+  CHECK(present == 1);
+  CHECK(elapsed >= 960000);
+
+  /* Nothing pulls the line down, the pull-up wins */
+  regs[GPIO_DATA_IN_REG/4] = LINE_MASK;
+  CHECK(oneWireReset(id) == 0);
+
+  /* The line is released between slots and never driven high */
+  CHECK(regs[GPIO_OE_REG/4] & LINE_MASK);
+  CHECK(!(regs[GPIO_OE_REG/4] & OTHER_MASK));
+  CHECK(!(regs[GPIO_SETDATAOUT_REG/4] & LINE_MASK));
+  CHECK(gpioGetDirection(8, 11) == GPIO_DIRECTION_INPUT);
+  CHECK(gpioGetDirection(8, 12) == GPIO_DIRECTION_OUTPUT);
+
+  /* Read slots sample the line after the master releases it */
+  byte = oneWireReadByte(id);
+  CHECK(byte == 0xFF);
+  regs[GPIO_DATA_IN_REG/4] = 0;
+  byte = oneWireReadByte(id);
+  CHECK(byte == 0x00);
+
+  /* Eight write slots take at least 70 micro seconds each */
+  start = gpioClockNs(CLOCK_MONOTONIC);
+  CHECK(oneWireWriteByte(id, 0xA5) == 0);
+  elapsed = gpioClockNs(CLOCK_MONOTONIC) - start;
+  CHECK(elapsed >= 8 * 70000);
+  CHECK(regs[GPIO_OE_REG/4] & LINE_MASK);
+
+  /* Scratchpad conversions, values from the DS18B20 and DS18S20 datasheets */
+  memset(scratch, 0, sizeof(scratch));
+  scratch[0] = 0x91;
+  scratch[1] = 0x01;
+  CHECK(scratchTemperature(0x28, scratch) == 25062);
+  scratch[0] = 0x5E;
+  scratch[1] = 0xFF;
+  CHECK(scratchTemperature(0x28, scratch) == -10125);
+  scratch[0] = 0x32;
+  scratch[1] = 0x00;
+  CHECK(scratchTemperature(DS18S20_FAMILY, scratch) == 25000);
+  scratch[6] = 0x0C;
+  scratch[7] = 0x10;
+  CHECK(scratchTemperature(DS18S20_FAMILY, scratch) == 25000);
+  scratch[6] = 0x04;
+  CHECK(scratchTemperature(DS18S20_FAMILY, scratch) == 25500);
+  scratch[0] = 0xCE;
+  scratch[1] = 0xFF;
+  scratch[7] = 0;
+  CHECK(scratchTemperature(DS18S20_FAMILY, scratch) == -25000);
+
+  /* Bad arguments are refused */
+  CHECK(oneWireReadTemperatures(id, NULL, 4) == -1);
+  CHECK(oneWireReadTemperatures(id, temps, -1) == -1);
+
+  oneWireClose(id);
+  CHECK(regs[GPIO_OE_REG/4] & LINE_MASK);
+  CHECK(oneWireReset(id) == -1);
+
+  closeGPIO();
+  return testResult("test_onewire");
+}
@@ -0,0 +1,55 @@
+/**********************************************************
+  Host test of the pad configuration against a memfd
+    register file standing in for /dev/mem
+
+  Written by Ankur Yadav (ankurayadav@gmail.com)
+
+  This code is made available under the BSD license.
+**********************************************************/
+
+/**
+ * @file test_pinmux.c
+ * @author Ankur Yadav (ankurayadav@gmail.com)
+ * @brief Host test of the pad configuration against a memfd register file standing in for /dev/mem
+ */
+
+#include "test_common.h"
+#include "bbbandroidHAL.h"
+#include "gpio_internal.h"
+
+#define CONTROL_MODULE_BASE  0x44E10000	/**< Control module, the conf_ pad registers start at 0x800 */
+#define CONF_P8_11           ((0x800 + 0x034) / 4)	/**< Pad register of P8_11 as index of uint32_t */
+#define CONF_P9_12           ((0x800 + 0x078) / 4)	/**< Pad register of P9_12 as index of uint32_t */
+
+int main(void)
+{
+  volatile uint32_t *regs;
+
+  if (testRegisterFile() || ((regs = testRegisters(CONTROL_MODULE_BASE)) == NULL)) {
+    printf("test_pinmux: cannot create the register file\n");
+    return 1;
+  }
+
+  /* Mux mode, pull and receiver bits land in the pad register of the pin */
+  CHECK(gpioPadSet(8, 11, 7, GPIO_PULL_UP, 1, 0) == 0);
+  CHECK(regs[CONF_P8_11] == 0x37);
+  CHECK(gpioPadSet(8, 11, 7, GPIO_PULL_DOWN, 1, 0) == 0);
+  CHECK(regs[CONF_P8_11] == 0x27);
+  CHECK(gpioPadSet(8, 11, 2, GPIO_PULL_NONE, 0, 1) == 0);
+  CHECK(regs[CONF_P8_11] == 0x4A);
+  CHECK(gpioPadGet(8, 11) == 0x4A);
+  CHECK(regs[CONF_P9_12] == 0);
+
+  /* Invalid settings and pins write nothing */
+  CHECK(gpioPadSet(8, 11, 8, GPIO_PULL_UP, 1, 0) == -1);
+  CHECK(gpioPadSet(8, 11, 7, 3, 1, 0) == -1);
+  CHECK(gpioPadSet(8, 1, 7, GPIO_PULL_UP, 1, 0) == -1);
+  CHECK(regs[CONF_P8_11] == 0x4A);
+
+  /* The read back only compares the seven configuration bits */
+  CHECK(gpioPadSetRaw(9, 12, 0x80 | 0x2F) == 0);
+  CHECK(gpioPadGet(9, 12) == 0x2F);
+
+  gpioPadClose();
+  return testResult("test_pinmux");
+}